@@ -0,0 +1,182 @@
+//
+//  benchmark_harness.cpp
+//  MeshEditE
+//
+
+#include "benchmark_harness.h"
+
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+
+using namespace std;
+
+/*=========================================================================*
+ *                     ALLOCATION COUNTING                                 *
+ *=========================================================================*/
+
+static atomic<size_t> _allocations( 0 );
+
+void* operator new( size_t size ){
+    _allocations.fetch_add( 1, memory_order_relaxed );
+    void* p = malloc( size == 0 ? 1 : size );
+    if( p == NULL ){ throw bad_alloc(); }
+    return p;
+}
+
+void* operator new[]( size_t size ){
+    return ::operator new( size );
+}
+
+void operator delete( void* p ) noexcept                { free( p ); }
+void operator delete[]( void* p ) noexcept              { free( p ); }
+void operator delete( void* p, size_t ) noexcept        { free( p ); }
+void operator delete[]( void* p, size_t ) noexcept      { free( p ); }
+
+namespace Benchmarks{
+
+size_t allocation_count(){
+    return _allocations.load( memory_order_relaxed );
+}
+
+/*=========================================================================*
+ *                     STATE                                               *
+ *=========================================================================*/
+
+State::State( long arg, size_t max_iterations ) : arg( arg ), max_iterations( max_iterations ) {}
+
+bool State::KeepRunning(){
+    if( !started ){
+        started = true;
+        ResumeTiming();
+    }
+    else{
+        ++done_iterations;
+    }
+
+    if( done_iterations < max_iterations ){ return true; }
+
+    PauseTiming();
+    return false;
+}
+
+void State::PauseTiming(){
+    if( paused ){ return; }
+    elapsed += chrono::duration<double>( clock::now() - t_start ).count();
+    allocs  += allocation_count() - allocs_start;
+    paused   = true;
+}
+
+void State::ResumeTiming(){
+    paused       = false;
+    allocs_start = allocation_count();
+    t_start      = clock::now();
+}
+
+/*=========================================================================*
+ *                     REGISTRY AND RUNNER                                 *
+ *=========================================================================*/
+
+static vector< Benchmark* >& registry(){
+    static vector< Benchmark* > benchmarks;
+    return benchmarks;
+}
+
+Benchmark* RegisterBenchmark( const string& name, BenchmarkFunction f ){
+    Benchmark* b = new Benchmark( name, f );
+    registry().push_back( b );
+    return b;
+}
+
+// the engine reports a lot on std::cout, it is silenced while benchmarking
+class NullBuffer : public streambuf{
+protected:
+    int overflow( int c ) override { return c; }
+};
+
+static string human_readable( double v ){
+    const char* suffix[] = { "", "k", "M", "G" };
+    int i = 0;
+    while( v >= 1000.0 && i < 3 ){ v /= 1000.0; ++i; }
+    ostringstream oss;
+    oss << fixed << setprecision( 2 ) << v << suffix[i];
+    return oss.str();
+}
+
+static State run_once( Benchmark& b, long arg, double min_time ){
+    size_t iterations = 1;
+    while( true ){
+        State state( arg, iterations );
+        b.f( state );
+
+        if( state.elapsedSeconds() >= min_time || iterations >= 1000000000 ){ return state; }
+
+        // same growth policy of google benchmark : aim past min_time, never more than 10x at once
+        double multiplier = ( state.elapsedSeconds() > 0.0 ) ? 1.4 * min_time / state.elapsedSeconds() : 10.0;
+        if( multiplier > 10.0 ){ multiplier = 10.0; }
+        size_t next = static_cast<size_t>( iterations * multiplier );
+        iterations  = ( next > iterations ) ? next : iterations + 1;
+    }
+}
+
+int RunSpecifiedBenchmarks( int argc, char** argv ){
+    string filter;
+    double min_time = 0.5;
+    bool   verbose  = false;
+
+    for( int i = 1; i < argc; ++i ){
+        string a = argv[i];
+        if( a.find( "--benchmark_filter=" ) == 0 )          { filter = a.substr( 19 ); }
+        else if( a.find( "--benchmark_min_time=" ) == 0 )   { min_time = atof( a.substr( 21 ).c_str( )); }
+        else if( a == "--benchmark_verbose" )               { verbose = true; }
+        else{
+            cerr << "unknown option : " << a << endl
+                 << "usage : " << argv[0] << " [--benchmark_filter=<substring>] [--benchmark_min_time=<seconds>]"
+                 << " [--benchmark_verbose]" << endl;
+            return 1;
+        }
+    }
+
+    NullBuffer  null_buffer;
+    ostream     report( cout.rdbuf( ));
+    streambuf*  cout_buffer = cout.rdbuf();
+    if( !verbose ){ cout.rdbuf( &null_buffer ); }
+
+    report << left  << setw( 40 ) << "Benchmark"
+           << right << setw( 16 ) << "Time (ns)"
+                    << setw( 12 ) << "Iterations"
+                    << setw( 14 ) << "vertices/s"
+                    << setw( 14 ) << "allocs/iter" << "  " << endl
+           << string( 98, '-' ) << endl;
+
+    for( Benchmark* b : registry( )){
+        vector<long> args = b->args;
+        if( args.empty( )){ args.push_back( 0 ); }
+
+        for( long arg : args ){
+            ostringstream name;
+            name << b->name;
+            if( !b->args.empty( )){ name << "/" << arg; }
+            if( !filter.empty() && name.str().find( filter ) == string::npos ){ continue; }
+
+            State  s             = run_once( *b, arg, min_time );
+            double n             = static_cast<double>( s.iterations( ));
+            double ns_per_iter   = s.elapsedSeconds() * 1e9 / n;
+            double items_per_sec = s.itemsPerIteration() * n / s.elapsedSeconds();
+            double allocs        = s.allocations() / n;
+
+            report << left  << setw( 40 ) << name.str()
+                   << right << setw( 16 ) << fixed << setprecision( 0 ) << ns_per_iter
+                            << setw( 12 ) << s.iterations()
+                            << setw( 14 ) << ( s.itemsPerIteration() > 0 ? human_readable( items_per_sec ) : "-" )
+                            << setw( 14 ) << setprecision( 1 ) << allocs << "  " << s.getLabel() << endl;
+        }
+    }
+    cout.rdbuf( cout_buffer );
+    return 0;
+}
+
+}
@@ -0,0 +1,93 @@
+//
+//  benchmark_harness.h
+//  MeshEditE
+//
+//  Minimal Google-Benchmark style harness : benchmarks register themselves with
+//  PAM_BENCHMARK, run for a minimum time and report time, throughput and
+//  heap allocations per iteration.
+//
+
+#ifndef __MeshEditE__benchmark_harness__
+#define __MeshEditE__benchmark_harness__
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <functional>
+
+namespace Benchmarks{
+
+/// number of calls to the global operator new since the start of the program
+size_t allocation_count();
+
+class State{
+public:
+    State( long arg, size_t max_iterations );
+
+    /// to be used as : while( state.KeepRunning( )){ ... }
+    bool            KeepRunning();
+    /// excludes setup code from both the timing and the allocation count
+    void            PauseTiming();
+    void            ResumeTiming();
+
+    inline long     range() const { return arg; }
+    /// items ( e.g. vertices ) processed per iteration, used for the throughput
+    inline void     SetItemsProcessed( size_t items ) { items_per_iteration = items; }
+    inline void     SetLabel( const std::string& l ) { label = l; }
+
+    inline size_t       iterations()        const { return done_iterations; }
+    inline double       elapsedSeconds()    const { return elapsed; }
+    inline size_t       allocations()       const { return allocs; }
+    inline size_t       itemsPerIteration() const { return items_per_iteration; }
+    inline const std::string& getLabel()    const { return label; }
+
+private:
+    typedef std::chrono::steady_clock clock;
+
+    long                arg;
+    size_t              max_iterations;
+    size_t              done_iterations     = 0;
+    size_t              items_per_iteration = 0;
+    bool                started             = false;
+    bool                paused              = false;
+    double              elapsed             = 0.0;
+    size_t              allocs              = 0;
+    clock::time_point   t_start;
+    size_t              allocs_start        = 0;
+    std::string         label;
+};
+
+typedef std::function< void( State& ) > BenchmarkFunction;
+
+class Benchmark{
+public:
+    Benchmark( const std::string& name, BenchmarkFunction f ) : name( name ), f( f ) {}
+    /// adds a value for State::range, the benchmark runs once for each of them
+    Benchmark*      Arg( long a ) { args.push_back( a ); return this; }
+    Benchmark*      DenseRange( long first, long last ) { for( long a = first; a <= last; ++a ){ args.push_back( a ); } return this; }
+
+    std::string         name;
+    BenchmarkFunction   f;
+    std::vector<long>   args;
+};
+
+Benchmark*  RegisterBenchmark( const std::string& name, BenchmarkFunction f );
+/// parses --benchmark_filter=<substring> and --benchmark_min_time=<seconds>
+int         RunSpecifiedBenchmarks( int argc, char** argv );
+
+/// prevents the compiler from optimizing away a computed value
+template< typename T >
+inline void DoNotOptimize( const T& value ){
+    asm volatile( "" : : "r,m"( value ) : "memory" );
+}
+
+}
+
+#define PAM_BENCHMARK_CONCAT2( a, b ) a##b
+#define PAM_BENCHMARK_CONCAT( a, b ) PAM_BENCHMARK_CONCAT2( a, b )
+#define PAM_BENCHMARK( f ) \
+    static ::Benchmarks::Benchmark* PAM_BENCHMARK_CONCAT( _pam_benchmark_, __LINE__ ) = \
+        ::Benchmarks::RegisterBenchmark( #f, f )
+
+#endif /* defined(__MeshEditE__benchmark_harness__) */
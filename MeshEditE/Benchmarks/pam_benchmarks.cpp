@@ -0,0 +1,283 @@
+//
+//  pam_benchmarks.cpp
+//  MeshEditE
+//
+//  Micro-benchmarks for the hot paths of the procedural engine.
+//  Every benchmark runs on synthetic PAMs : a PAM box refined with polar_subdivide,
+//  the argument of the benchmark is the number of subdivision steps.
+//
+//  usage : pam_benchmarks [--benchmark_filter=<substring>] [--benchmark_min_time=<seconds>]
+//
+
+#include <stdio.h>
+#include <set>
+#include <vector>
+
+#include <GEL/HMesh/Manifold.h>
+#include <GEL/CGLA/Vec3d.h>
+#include <GEL/CGLA/Mat4x4d.h>
+
+#include "polarize.h"
+
+#include <MeshEditE/Procedural/Operations/basic_shapes.h>
+#include <MeshEditE/Procedural/Operations/structural_operations.h>
+#include <MeshEditE/Procedural/Helpers/geometric_properties.h>
+#include <MeshEditE/Procedural/Helpers/manifold_copy.h>
+#include <MeshEditE/Procedural/Matches/graph_match.h>
+#include <MeshEditE/Procedural/StatefulEngine.h>
+#include <MeshEditE/Procedural/collision_detection.h>
+#include <MeshEditE/Procedural/pam_skeleton.h>
+
+#include "benchmark_harness.h"
+
+using namespace std;
+using namespace HMesh;
+using namespace CGLA;
+
+using namespace Benchmarks;
+using namespace Procedural;
+using namespace Procedural::Engines;
+using namespace Procedural::GraphMatch;
+
+#define MIN_LEVEL 1
+#define MAX_LEVEL 5
+
+/*=========================================================================*
+ *                     SYNTHETIC PAMs                                      *
+ *=========================================================================*/
+
+static void make_PAM( Manifold& m, int level, const Vec3d& offset = Vec3d( 0.0 )){
+    m.clear();
+    Procedural::Operations::create_PAM_box( m, 2.0, 1.0, 1.0 );
+    polar_subdivide( m, level );
+    for( VertexID v : m.vertices( )){ m.pos( v ) += offset; }
+}
+
+static set<VertexID> poles_of( Manifold& m ){
+    set<VertexID> poles;
+    for( VertexID v : m.vertices( )){
+        if( is_pole( m, v )){ poles.insert( v ); }
+    }
+    return poles;
+}
+
+// the pole with the greatest ( or smallest ) x coordinate
+static VertexID extreme_pole( Manifold& m, const set<VertexID>& poles, bool max_x ){
+    VertexID best = *poles.begin();
+    for( VertexID p : poles ){
+        if(( m.pos( p )[0] > m.pos( best )[0] ) == max_x ){ best = p; }
+    }
+    return best;
+}
+
+/*=========================================================================*
+ *                     BENCHMARKS                                          *
+ *=========================================================================*/
+
+static void BM_label_PAM_edges( State& state ){
+    Manifold m;
+    make_PAM( m, static_cast<int>( state.range( )));
+
+    while( state.KeepRunning( )){
+        HalfEdgeAttributeVector<EdgeInfo> edge_info = label_PAM_edges( m );
+        DoNotOptimize( edge_info );
+    }
+    state.SetItemsProcessed( m.no_vertices( ));
+}
+PAM_BENCHMARK( BM_label_PAM_edges )->DenseRange( MIN_LEVEL, MAX_LEVEL );
+
+
+static void BM_Skeleton_build( State& state ){
+    Manifold m;
+    make_PAM( m, static_cast<int>( state.range( )));
+    set<VertexID> poles = poles_of( m );
+
+    while( state.KeepRunning( )){
+        Skeleton s;
+        s.build( m, poles );
+        DoNotOptimize( s );
+    }
+    state.SetItemsProcessed( m.no_vertices( ));
+}
+PAM_BENCHMARK( BM_Skeleton_build )->DenseRange( MIN_LEVEL, MAX_LEVEL );
+
+
+static void BM_collide( State& state ){
+    Manifold m1, m2;
+    make_PAM( m1, static_cast<int>( state.range( )));
+    // overlapping by a quarter of the length, so that the whole hierarchy is visited
+    make_PAM( m2, static_cast<int>( state.range( )), Vec3d( 1.5, 0.0, 0.0 ));
+    Skeleton s1, s2;
+    s1.build( m1, poles_of( m1 ));
+    s2.build( m2, poles_of( m2 ));
+
+    while( state.KeepRunning( )){
+        bool c = collide( s1, s2 );
+        DoNotOptimize( c );
+    }
+    state.SetItemsProcessed( m1.no_vertices() + m2.no_vertices( ));
+}
+PAM_BENCHMARK( BM_collide )->DenseRange( MIN_LEVEL, MAX_LEVEL );
+
+
+static void BM_distance_from_poles( State& state ){
+    Manifold m;
+    make_PAM( m, static_cast<int>( state.range( )));
+    HalfEdgeAttributeVector<EdgeInfo> edge_info = label_PAM_edges( m );
+
+    while( state.KeepRunning( )){
+        VertexAttributeVector<Procedural::Geometry::DistanceMetrics> distances;
+        Procedural::Geometry::distance_from_poles( m, edge_info, distances, false );
+        DoNotOptimize( distances );
+    }
+    state.SetItemsProcessed( m.no_vertices( ));
+}
+PAM_BENCHMARK( BM_distance_from_poles )->DenseRange( MIN_LEVEL, MAX_LEVEL );
+
+
+static void BM_distance_fields( State& state ){
+    Manifold m;
+    make_PAM( m, static_cast<int>( state.range( )));
+    HalfEdgeAttributeVector<EdgeInfo> edge_info = label_PAM_edges( m );
+
+    while( state.KeepRunning( )){
+        VertexAttributeVector<Procedural::Geometry::DistanceMetrics> poles, junctions, combined;
+        Procedural::Geometry::distance_fields( m, edge_info, poles, junctions, combined );
+        DoNotOptimize( combined );
+    }
+    state.SetItemsProcessed( m.no_vertices( ));
+}
+PAM_BENCHMARK( BM_distance_fields )->DenseRange( MIN_LEVEL, MAX_LEVEL );
+
+
+static void BM_add_manifold( State& state ){
+    Manifold host, module;
+    make_PAM( host, static_cast<int>( state.range( )));
+    make_PAM( module, static_cast<int>( state.range( )), Vec3d( 3.0, 0.0, 0.0 ));
+
+    while( state.KeepRunning( )){
+        state.PauseTiming();
+        Manifold        h = host;
+        VertexIDRemap   host_remap, module_remap;
+        set<VertexID>   module_IDs;
+        state.ResumeTiming();
+
+        Procedural::Helpers::add_manifold( h, module, host_remap, module_remap, module_IDs );
+        DoNotOptimize( h );
+    }
+    state.SetItemsProcessed( module.no_vertices( ));
+}
+PAM_BENCHMARK( BM_add_manifold )->DenseRange( MIN_LEVEL, MAX_LEVEL );
+
+
+static void BM_glue_poles( State& state ){
+    Manifold host, module;
+    make_PAM( host, static_cast<int>( state.range( )));
+    make_PAM( module, static_cast<int>( state.range( )), Vec3d( 3.0, 0.0, 0.0 ));
+
+    VertexIDRemap   host_remap, module_remap;
+    set<VertexID>   module_IDs;
+    Procedural::Helpers::add_manifold( host, module, host_remap, module_remap, module_IDs );
+
+    // glue the right pole of the host to the left pole of the module
+    set<VertexID> host_poles, module_poles;
+    for( VertexID p : poles_of( host )){
+        if( module_IDs.count( p ) > 0 ){ module_poles.insert( p ); }
+        else                           { host_poles.insert( p ); }
+    }
+    VertexID h_pole = extreme_pole( host, host_poles, true );
+    VertexID m_pole = extreme_pole( host, module_poles, false );
+
+    while( state.KeepRunning( )){
+        state.PauseTiming();
+        Manifold m = host;
+        state.ResumeTiming();
+
+        bool glued = Procedural::Operations::Structural::glue_poles( m, h_pole, m_pole );
+        DoNotOptimize( glued );
+    }
+    state.SetItemsProcessed( host.no_vertices( ));
+}
+PAM_BENCHMARK( BM_glue_poles )->DenseRange( MIN_LEVEL, MAX_LEVEL );
+
+
+static void BM_get_subsets( State& state ){
+    Manifold host, module_mesh;
+    make_PAM( host, static_cast<int>( state.range( )));
+    make_PAM( module_mesh, static_cast<int>( state.range( )), Vec3d( 3.0, 0.0, 0.0 ));
+
+    MainStructure   main;
+    Module          host_module( host, 0 ), module( module_mesh, 0 );
+    vector<Match>   no_matches;
+    main.glueModule( host_module, no_matches );
+
+    TransformedModuleView view( module, identity_Mat4x4d( ));
+    vector<Match>         proposed;
+    for( size_t i = 0; i < module.poleList.size() && i < main.getFreePoles().size(); ++i ){
+        proposed.push_back( make_pair( module.poleList[i], main.getFreePoles()[i] ));
+    }
+
+    while( state.KeepRunning( )){
+        vector<SubsetResult> results;
+        get_subsets( main, view, proposed, results, make_pair( 0.5, 0.5 ));
+        DoNotOptimize( results );
+    }
+    state.SetItemsProcessed( proposed.size( ));
+    state.SetLabel( "items are matches" );
+}
+PAM_BENCHMARK( BM_get_subsets )->DenseRange( MIN_LEVEL, MAX_LEVEL );
+
+
+static void BM_testMultipleTransformations( State& state ){
+    Manifold host, module_mesh;
+    make_PAM( host, static_cast<int>( state.range( )));
+    make_PAM( module_mesh, static_cast<int>( state.range( )));
+
+    StatefulEngine& s = StatefulEngine::getCurrentEngine();
+    s.setSeed( 42 );
+    s.setHost( host );
+    Module module( module_mesh, 0 );
+
+    while( state.KeepRunning( )){
+        s.setModule( module );
+        // on failure the engine is consolidated by testMultipleTransformations itself
+        if( s.testMultipleTransformations( )){ s.consolidate(); }
+    }
+    state.SetItemsProcessed( host.no_vertices() + module_mesh.no_vertices( ));
+    // host is about to go out of scope
+    s.reset();
+}
+PAM_BENCHMARK( BM_testMultipleTransformations )->DenseRange( MIN_LEVEL, MAX_LEVEL );
+
+
+// same setup as BM_testMultipleTransformations, the label reports how many poses were evaluated
+static void BM_testMultipleTransformations_coarse_to_fine( State& state ){
+    Manifold host, module_mesh;
+    make_PAM( host, static_cast<int>( state.range( )));
+    make_PAM( module_mesh, static_cast<int>( state.range( )));
+
+    StatefulEngine& s = StatefulEngine::getCurrentEngine();
+    s.setSeed( 42 );
+    s.setHost( host );
+    s.setPoseSearch( StatefulEngine::Search_CoarseToFine );
+    s.resetTimings();
+    Module module( module_mesh, 0 );
+
+    size_t no_steps = 0;
+    while( state.KeepRunning( )){
+        s.setModule( module );
+        if( s.testMultipleTransformations( )){ s.consolidate(); }
+        ++no_steps;
+    }
+    // the engine is shared with the other benchmarks
+    s.setPoseSearch( StatefulEngine::Search_Exhaustive );
+    state.SetItemsProcessed( host.no_vertices() + module_mesh.no_vertices( ));
+    state.SetLabel( to_string( s.getTimings().no_evaluations / std::max<size_t>( 1, no_steps )) + " evaluations per step" );
+    s.reset();
+}
+PAM_BENCHMARK( BM_testMultipleTransformations_coarse_to_fine )->DenseRange( MIN_LEVEL, MAX_LEVEL );
+
+
+int main( int argc, char** argv ){
+    return Benchmarks::RunSpecifiedBenchmarks( argc, argv );
+}
@@ -0,0 +1,181 @@
+//
+//  pam_checks.cpp
+//  MeshEditE
+//
+//  Brute force checks of the search structures used by the engine : the minimum cost
+//  assignment against all the permutations, PoleGrid::kNearest and PoleGrid::inSphere
+//  against a linear scan ( including the sparse grids that end in the full scan fallback ).
+//  Inputs are random with fixed seeds, the program returns the number of failed checks.
+//
+//  usage : pam_checks
+//
+
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <iostream>
+
+#include <GEL/HMesh/Manifold.h>
+#include <GEL/CGLA/Vec3d.h>
+
+#include <MeshEditE/Procedural/PoleGrid.h>
+#include <MeshEditE/Procedural/Helpers/min_cost_assignment.h>
+
+using namespace std;
+using namespace HMesh;
+using namespace CGLA;
+
+using namespace Procedural;
+using namespace Procedural::Helpers;
+
+/*=========================================================================*
+ *                     MIN COST ASSIGNMENT                                 *
+ *=========================================================================*/
+
+// every row gets a distinct column and the total is the one of the best permutation.
+// some costs are repeated and some are "forbidden", as matchModuleToHost uses them
+static size_t check_assignment(){
+    mt19937             rng( 3 );
+    AssignmentSolver    solver;
+    vector< int >       row_to_col;
+    size_t              failed = 0;
+
+    for( int t = 0; t < 3000; ++t ){
+        size_t no_rows = 1 + rng() % 6,
+               no_cols = no_rows + rng() % 4;
+        vector< double > c( no_rows * no_cols );
+        solver.reset( no_rows, no_cols, 0.0 );
+        for( size_t r = 0; r < no_rows; ++r ){
+            for( size_t k = 0; k < no_cols; ++k ){
+                double cost = ( t % 3 == 0 ) ? static_cast< double >( rng() % 4 ) : ( rng() % 1000 ) / 10.0;
+                if( t % 5 == 0 && rng() % 4 == 0 ){ cost = 1e6; }
+                c[r * no_cols + k]  = cost;
+                solver.cost( r, k ) = cost;
+            }
+        }
+        double total = solver.solve( row_to_col );
+
+        vector< int > perm( no_cols );
+        for( size_t k = 0; k < no_cols; ++k ){ perm[k] = static_cast< int >( k ); }
+        double best = HUGE_VAL;
+        do{
+            double sum = 0.0;
+            for( size_t r = 0; r < no_rows; ++r ){ sum += c[r * no_cols + perm[r]]; }
+            best = min( best, sum );
+        } while( next_permutation( perm.begin(), perm.end( )));
+
+        vector< bool >  used( no_cols, false );
+        double          sum     = 0.0;
+        bool            valid   = ( row_to_col.size() == no_rows );
+        for( size_t r = 0; valid && r < no_rows; ++r ){
+            int k = row_to_col[r];
+            if( k < 0 || k >= static_cast< int >( no_cols ) || used[k] ){ valid = false; break; }
+            used[k] = true;
+            sum    += c[r * no_cols + k];
+        }
+        if( !valid || fabs( sum - total ) > 1e-6 || fabs( best - total ) > 1e-6 ){
+            cout << "assignment " << t << " : " << no_rows << "x" << no_cols << " got " << total
+                 << " expected " << best << endl;
+            ++failed;
+        }
+    }
+    return failed;
+}
+
+/*=========================================================================*
+ *                     POLE GRID                                           *
+ *=========================================================================*/
+
+struct GridPoint{
+    VertexID    id;
+    Vec3d       pos;
+};
+
+static bool sameDistances( const vector< PoleGrid::IDDist >& got, vector< double >& expected, size_t k ){
+    sort( expected.begin(), expected.end( ));
+    if( expected.size() > k ){ expected.resize( k ); }
+    if( got.size() != expected.size( )){ return false; }
+    for( size_t i = 0; i < got.size(); ++i ){
+        if( fabs( got[i].second - expected[i] ) > 1e-12 ){ return false; }
+    }
+    return true;
+}
+
+// the points are spread with the given cell size, then one third of them is erased.
+// far queries on a sparse grid go through the full scan fallback
+static size_t check_grid( unsigned seed, size_t no_points, double spread, double cell_size ){
+    mt19937                             rng( seed );
+    uniform_real_distribution< double > U( -spread, spread );
+    PoleGrid                            grid( cell_size );
+    vector< GridPoint >                 points, live;
+    size_t                              failed = 0;
+
+    for( size_t i = 0; i < no_points; ++i ){
+        GridPoint gp = { VertexID( i ), Vec3d( U( rng ), U( rng ) * 0.3, U( rng )) };
+        points.push_back( gp );
+        grid.insert( gp.id, gp.pos );
+    }
+    for( size_t i = 0; i < no_points; ++i ){
+        if( i % 3 == 0 ){ grid.erase( points[i].id, points[i].pos ); }
+        else            { live.push_back( points[i] ); }
+    }
+    if( grid.size() != live.size( )){ ++failed; }
+
+    auto even = []( VertexID v ){ return ( v.get_index() % 2 ) == 0; };
+    vector< PoleGrid::IDDist > result;
+
+    for( int q = 0; q < 1000; ++q ){
+        double  far         = ( q % 7 == 0 ) ? 20.0 : 1.5;
+        Vec3d   p( U( rng ) * far, U( rng ), U( rng ) * far );
+        size_t  k           = 1 + q % 5;
+        double  max_dist    = ( q % 4 == 0 ) ? spread / 10.0 : HUGE_VAL;
+        double  radius      = spread / 10.0 * ( q % 3 );
+
+        vector< double > expected;
+        for( const GridPoint& gp : live ){
+            double d = ( gp.pos - p ).length();
+            if( d <= max_dist && even( gp.id )){ expected.push_back( d ); }
+        }
+        grid.kNearest( p, k, max_dist, even, result );
+        if( !sameDistances( result, expected, k )){
+            cout << "kNearest " << q << " ( seed " << seed << " ) : " << result.size() << " points" << endl;
+            ++failed;
+        }
+
+        size_t in_sphere = 0;
+        for( const GridPoint& gp : live ){
+            if(( gp.pos - p ).length() <= radius && even( gp.id )){ ++in_sphere; }
+        }
+        grid.inSphere( p, radius, even, result );
+        if( result.size() != in_sphere ){
+            cout << "inSphere " << q << " ( seed " << seed << " ) : " << result.size()
+                 << " points, expected " << in_sphere << endl;
+            ++failed;
+        }
+    }
+
+    // rehashing keeps every point
+    grid.setCellSize( cell_size * 0.37 );
+    vector< double > all;
+    for( const GridPoint& gp : live ){ all.push_back( gp.pos.length( )); }
+    grid.kNearest( Vec3d( 0.0 ), 3, HUGE_VAL, []( VertexID ){ return true; }, result );
+    if( grid.size() != live.size() || !sameDistances( result, all, 3 )){
+        cout << "setCellSize ( seed " << seed << " )" << endl;
+        ++failed;
+    }
+    return failed;
+}
+
+
+int main( int argc, char** argv ){
+    size_t failed = 0;
+    failed += check_assignment();
+    failed += check_grid( 1, 3000, 50.0, 3.0 );     // dense
+    failed += check_grid( 2, 40, 50.0, 0.5 );       // sparse, mostly empty cells
+    failed += check_grid( 3, 300, 10.0, 8.0 );      // few large cells
+
+    cout << ( failed == 0 ? "all checks passed" : to_string( failed ) + " checks failed" ) << endl;
+    return static_cast< int >( min< size_t >( failed, 255 ));
+}
@@ -8,12 +8,155 @@
 
 #include "HMeshParallelKit.h"
 
+using namespace std;
+using namespace HMesh;
+
+// set on the pool threads, and on the calling thread while it takes part in a job
+static thread_local bool inside_job = false;
+
+ThreadPool& ThreadPool::get() {
+    static ThreadPool pool(max(1u, thread::hardware_concurrency()));
+    return pool;
+}
+
+ThreadPool::ThreadPool(size_t no_threads) : shares(new Share[no_threads]) {
+    for(size_t t = 1; t < no_threads; ++t)
+        workers.push_back(thread(&ThreadPool::worker_loop, this, t));
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> l(state_mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for(auto& w : workers)
+        w.join();
+}
+
+void ThreadPool::run(size_t n, size_t _grain, const RangeTask& _task) {
+    if(n == 0) return;
+    size_t P = no_threads();
+    if(_grain == 0)
+        _grain = max(size_t(1), n / (8 * P));
+    
+    if(inside_job || P == 1 || n <= _grain) {
+        for(size_t b = 0; b < n; b += _grain)
+            _task(b, min(n, b + _grain));
+        return;
+    }
+    
+    lock_guard<mutex> job(job_mutex);
+    for(size_t t = 0; t < P; ++t) {
+        lock_guard<mutex> l(shares[t].lock);
+        shares[t].begin = n * t / P;
+        shares[t].end   = n * (t + 1) / P;
+    }
+    {
+        lock_guard<mutex> l(state_mutex);
+        task  = &_task;
+        grain = _grain;
+        busy  = workers.size();
+        ++generation;
+    }
+    wake.notify_all();
+    
+    inside_job = true;
+    work(0);
+    inside_job = false;
+    
+    unique_lock<mutex> l(state_mutex);
+    done.wait(l, [&] { return busy == 0; });
+    task = 0;
+}
+
+void ThreadPool::worker_loop(size_t id) {
+    inside_job = true;
+    size_t seen = 0;
+    for(;;) {
+        {
+            unique_lock<mutex> l(state_mutex);
+            wake.wait(l, [&] { return quit || generation != seen; });
+            if(quit) return;
+            seen = generation;
+        }
+        work(id);
+        {
+            lock_guard<mutex> l(state_mutex);
+            if(--busy == 0)
+                done.notify_one();
+        }
+    }
+}
+
+void ThreadPool::work(size_t id) {
+    size_t b, e;
+    while(pop(id, b, e) || steal(id, b, e))
+        (*task)(b, e);
+}
+
+bool ThreadPool::pop(size_t id, size_t& b, size_t& e) {
+    Share& s = shares[id];
+    lock_guard<mutex> l(s.lock);
+    if(s.begin >= s.end) return false;
+    b = s.begin;
+    e = min(s.end, b + grain);
+    s.begin = e;
+    return true;
+}
+
+bool ThreadPool::steal(size_t id, size_t& b, size_t& e) {
+    size_t P = no_threads();
+    for(size_t k = 1; k < P; ++k) {
+        Share& victim = shares[(id + k) % P];
+        size_t from, to;
+        {
+            lock_guard<mutex> l(victim.lock);
+            if(victim.begin >= victim.end) continue;
+            // the back half, or everything if only one chunk is left
+            from = (victim.end - victim.begin > grain) ? victim.begin + (victim.end - victim.begin) / 2 : victim.begin;
+            to   = victim.end;
+            victim.end = from;
+        }
+        b = from;
+        e = min(to, from + grain);
+        if(e < to) {
+            lock_guard<mutex> l(shares[id].lock);
+            shares[id].begin = e;
+            shares[id].end   = to;
+        }
+        return true;
+    }
+    return false;
+}
+
+vector<VertexID> vertex_ids(const Manifold& m) {
+    vector<VertexID> ids;
+    ids.reserve(m.no_vertices());
+    for(auto v : m.vertices()) ids.push_back(v);
+    return ids;
+}
+
+vector<FaceID> face_ids(const Manifold& m) {
+    vector<FaceID> ids;
+    ids.reserve(m.no_faces());
+    for(auto f : m.faces()) ids.push_back(f);
+    return ids;
+}
+
+vector<HalfEdgeID> halfedge_ids(const Manifold& m) {
+    vector<HalfEdgeID> ids;
+    ids.reserve(m.no_halfedges());
+    for(auto h : m.halfedges()) ids.push_back(h);
+    return ids;
+}
+
 VertexIDBatches batch_vertices(const HMesh::Manifold& m) {
-    VertexIDBatches vertex_ids(CORES);
-    auto batch_size = m.no_vertices()/CORES;
-    int cnt = 0;
+    size_t no_batches = ThreadPool::get().no_threads();
+    VertexIDBatches vertex_ids(no_batches);
+    size_t cnt = 0, n = m.no_vertices();
     for_each_vertex(m, [&](HMesh::VertexID v) {
-        vertex_ids[(cnt++/batch_size)%CORES].push_back(v);
+        vertex_ids[cnt++ * no_batches / n].push_back(v);
     });
     return vertex_ids;
 }
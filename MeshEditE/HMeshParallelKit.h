@@ -23,10 +23,12 @@
 
 #include <thread>
 #include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
 #include <GEL/HMesh/Manifold.h>
 
-const int CORES = 16;
-
 
 class range {
 public:
@@ -56,20 +58,85 @@ private:
 };
 
 
+/** Persistent pool of worker threads, one per hardware thread ( the calling thread is one of them ).
+ The index range of a job is split in contiguous chunks, each thread starts on its own share and,
+ when done, steals half of what is left of another thread's share. Calls from inside a job run
+ serially on the calling thread. */
+class ThreadPool {
+public:
+    typedef std::function<void(size_t, size_t)> RangeTask;
+    
+    static ThreadPool& get();
+    
+    size_t no_threads() const { return workers.size() + 1; }
+    
+    /// calls task(b, e) on disjoint chunks covering [0, n), each at most grain long. grain = 0 picks one.
+    void run(size_t n, size_t grain, const RangeTask& task);
+    
+    ~ThreadPool();
+    
+private:
+    struct Share {
+        std::mutex lock;
+        size_t begin = 0, end = 0;
+    };
+    
+    ThreadPool(size_t no_threads);
+    void worker_loop(size_t id);
+    void work(size_t id);
+    bool pop(size_t id, size_t& b, size_t& e);
+    bool steal(size_t id, size_t& b, size_t& e);
+    
+    std::vector<std::thread>    workers;
+    std::unique_ptr<Share[]>    shares;
+    std::mutex                  job_mutex;
+    std::mutex                  state_mutex;
+    std::condition_variable     wake, done;
+    const RangeTask*            task = 0;
+    size_t                      grain = 1;
+    size_t                      generation = 0;
+    size_t                      busy = 0;
+    bool                        quit = false;
+};
+
+template<typename F>
+inline void parallel_for(size_t begin, size_t end, const F& f, size_t grain = 0) {
+    if(end <= begin) return;
+    ThreadPool::get().run(end - begin, grain, [&](size_t b, size_t e) {
+        for(size_t i = b; i < e; ++i)
+            f(begin + i);
+    });
+}
+
+template<typename ID, typename F>
+inline void parallel_for(const std::vector<ID>& ids, const F& f, size_t grain = 0) {
+    parallel_for(size_t(0), ids.size(), [&](size_t i) { f(ids[i]); }, grain);
+}
+
+/// the IDs of the items in use, computed once and reused by kernels that iterate
+std::vector<HMesh::VertexID>    vertex_ids(const HMesh::Manifold& m);
+std::vector<HMesh::FaceID>      face_ids(const HMesh::Manifold& m);
+std::vector<HMesh::HalfEdgeID>  halfedge_ids(const HMesh::Manifold& m);
+
+template<typename F>
+inline void parallel_for_vertices(const HMesh::Manifold& m, const F& f) { parallel_for(vertex_ids(m), f); }
+template<typename F>
+inline void parallel_for_faces(const HMesh::Manifold& m, const F& f) { parallel_for(face_ids(m), f); }
+template<typename F>
+inline void parallel_for_halfedges(const HMesh::Manifold& m, const F& f) { parallel_for(halfedge_ids(m), f); }
+
+
 typedef std::vector<std::vector<HMesh::VertexID>> VertexIDBatches;
 
 template<typename  T>
-inline void for_each_vertex_parallel(int no_threads, const VertexIDBatches& batches, const T& f) {
-    std::vector<std::thread> t_vec(no_threads);
-    for(auto t : range(0, no_threads))
-        t_vec[t] = std::thread(f, ref(batches[t]));
-    for(auto t : range(0, no_threads))
-        t_vec[t].join();
+inline void for_each_vertex_parallel(const VertexIDBatches& batches, const T& f) {
+    parallel_for(size_t(0), batches.size(), [&](size_t t) { f(batches[t]); }, 1);
 }
 
 inline void for_each_vertex(HMesh::Manifold& m, std::function<void(HMesh::VertexID)> f) { for(auto v : m.vertices()) f(v); }
 inline void for_each_vertex(const HMesh::Manifold& m, std::function<void(HMesh::VertexID)> f) { for(auto v : m.vertices()) f(v); }
 
+/// one batch per pool thread
 VertexIDBatches batch_vertices(const HMesh::Manifold& m);
 
 #endif
@@ -0,0 +1,40 @@
+//
+//  debug_colors_headless.cpp
+//  MeshEditE
+//
+//  Headless implementation of debug_colors.h, the colors and texture coordinates are
+//  stored and never shown.
+//
+
+#include <MeshEditE/debug_colors.h>
+
+using namespace CGLA;
+using namespace HMesh;
+
+namespace
+{
+    VertexAttributeVector<Vec3f>    vertex_colors;
+    HalfEdgeAttributeVector<Vec3f>  edge_colors;
+    FaceAttributeVector<Vec3f>      face_colors;
+    VertexAttributeVector<Vec2f>    vertex_uvs;
+}
+
+Vec3f& debug_vertex_color ( VertexID v )
+{
+    return vertex_colors[v];
+}
+
+Vec3f& debug_edge_color ( HalfEdgeID h )
+{
+    return edge_colors[h];
+}
+
+Vec3f& debug_face_color ( FaceID f )
+{
+    return face_colors[f];
+}
+
+Vec2f& debug_vertex_uv ( VertexID v )
+{
+    return vertex_uvs[v];
+}
@@ -0,0 +1,162 @@
+//
+//  pam_generate.cpp
+//  MeshEditE
+//
+//  Command line driver for the procedural engine, it does not need the MeshEditor GUI.
+//
+//  usage : pam_generate --toolbox <toolbox.json> --host <host.obj> --out <result.obj>
+//                       [--steps N] [--seed S] [--workers W] [--serial] [--no-culling]
+//                       [--max-evals N] [--max-secs S] [--good-enough C] [--best-first]
+//                       [--coarse-to-fine] [--coarse-angles N] [--refined N]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+
+#include <GEL/HMesh/Manifold.h>
+#include <GEL/HMesh/obj_load.h>
+#include <GEL/HMesh/obj_save.h>
+#include <GEL/Util/Timer.h>
+
+#include <MeshEditE/Procedural/StatefulEngine.h>
+#include <MeshEditE/Procedural/Toolbox.h>
+#include <MeshEditE/Procedural/Helpers/toolbox_step.h>
+
+using namespace std;
+using namespace HMesh;
+
+using namespace Procedural;
+using namespace Procedural::Engines;
+using namespace Procedural::Helpers;
+
+struct GeneratorOptions{
+    string          toolbox;
+    string          host;
+    string          out;
+    size_t          no_steps    = 0;            // 0 means until the toolbox is empty
+    unsigned long   seed        = 0;
+    bool            has_seed    = false;
+    size_t          no_workers  = 0;
+    bool            serial      = false;
+    bool            culling     = true;
+    SearchBudget    budget;
+    bool            coarse_to_fine  = false;
+    size_t          coarse_angles   = 4;
+    size_t          refined         = 8;
+};
+
+static void usage( const char* name ){
+    cerr << "usage : " << name << " --toolbox <toolbox.json> --host <host.obj> --out <result.obj>" << endl
+         << "        [--steps N] [--seed S] [--workers W] [--serial] [--no-culling]" << endl
+         << "        [--max-evals N] [--max-secs S] [--good-enough C] [--best-first]" << endl
+         << "        [--coarse-to-fine] [--coarse-angles N] [--refined N]" << endl;
+}
+
+static bool parse_options( int argc, char** argv, GeneratorOptions& o ){
+    for( int i = 1; i < argc; ++i ){
+        string arg = argv[i];
+        bool   has_value = ( i + 1 < argc );
+        
+        if( arg == "--serial" )                     { o.serial = true; }
+        else if( arg == "--no-culling" )            { o.culling = false; }
+        else if( arg == "--best-first" )            { o.budget.bestFirst = true; }
+        else if( arg == "--coarse-to-fine" )        { o.coarse_to_fine = true; }
+        else if( arg == "--toolbox" && has_value )  { o.toolbox = argv[++i]; }
+        else if( arg == "--host"    && has_value )  { o.host    = argv[++i]; }
+        else if( arg == "--out"     && has_value )  { o.out     = argv[++i]; }
+        else if( arg == "--steps"   && has_value )  { o.no_steps   = strtoul( argv[++i], NULL, 10 ); }
+        else if( arg == "--workers" && has_value )  { o.no_workers = strtoul( argv[++i], NULL, 10 ); }
+        else if( arg == "--seed"    && has_value )  { o.seed = strtoul( argv[++i], NULL, 10 ); o.has_seed = true; }
+        else if( arg == "--max-evals"   && has_value )  { o.budget.maxEvaluations = strtoul( argv[++i], NULL, 10 ); }
+        else if( arg == "--max-secs"    && has_value )  { o.budget.maxSeconds     = strtod( argv[++i], NULL ); }
+        else if( arg == "--good-enough" && has_value )  { o.budget.goodEnoughCost = strtod( argv[++i], NULL ); }
+        else if( arg == "--coarse-angles" && has_value ){ o.coarse_angles = std::max( 1ul, strtoul( argv[++i], NULL, 10 )); }
+        else if( arg == "--refined"     && has_value )  { o.refined       = strtoul( argv[++i], NULL, 10 ); }
+        else{
+            cerr << "unknown or incomplete option : " << arg << endl;
+            return false;
+        }
+    }
+    return !( o.toolbox.empty() || o.host.empty() || o.out.empty( ));
+}
+
+static void print_timings( ostream& out, const PhaseTimings& pt, double total ){
+    out << fixed << setprecision( 4 )
+        << "transforms generated : " << pt.no_transforms << endl
+        << "transforms evaluated : " << pt.no_evaluations << endl
+        << "early exits          : " << pt.no_early_exits << endl
+        << "refined poses        : " << pt.no_refined << endl
+        << "glueings             : " << pt.no_glueings   << endl
+        << "transform list       : " << pt.transformList << "s" << endl
+        << "matching             : " << pt.matching      << "s (summed over workers)" << endl
+        << "subset pruning       : " << pt.subsets       << "s (summed over workers)" << endl
+        << "collision            : " << pt.collision     << "s" << endl
+        << "refinement           : " << pt.refinement    << "s" << endl
+        << "glue                 : " << pt.glue          << "s" << endl
+        << "bake                 : " << pt.bake          << "s" << endl
+        << "total                : " << total            << "s" << endl;
+}
+
+int main( int argc, char** argv ){
+    GeneratorOptions options;
+    if( !parse_options( argc, argv, options )){
+        usage( argv[0] );
+        return 1;
+    }
+    
+    Manifold host;
+    if( !obj_load( options.host, host )){
+        cerr << "unable to load host : " << options.host << endl;
+        return 1;
+    }
+    
+    Toolbox&        t = Toolbox::getToolboxInstance();
+    StatefulEngine& s = StatefulEngine::getCurrentEngine();
+    
+    if( options.has_seed ){
+        // the two generators must not share the sequence
+        t.setSeed( options.seed );
+        s.setSeed( options.seed + 1 );
+    }
+    s.setEvaluationMode( options.serial ? StatefulEngine::Evaluation_Serial
+                                        : StatefulEngine::Evaluation_Deterministic, options.no_workers );
+    s.setCollisionCulling( options.culling );
+    s.setSearchBudget( options.budget );
+    s.setPoseSearch( options.coarse_to_fine ? StatefulEngine::Search_CoarseToFine : StatefulEngine::Search_Exhaustive,
+                     options.coarse_angles, options.refined );
+    
+    t.clear();
+    if( !t.fromJson( options.toolbox )){
+        cerr << "unable to load toolbox : " << options.toolbox << endl;
+        return 1;
+    }
+    s.setHost( host );
+    s.resetTimings();
+    
+    Util::Timer timer;
+    timer.start();
+    
+    toolbox_step_result result;
+    size_t              step = 0;
+    while( result.ok() && ( options.no_steps == 0 || step < options.no_steps )){
+        result = toolbox_step( t, s );
+        ++step;
+    }
+    // the engine glues module instances, the mesh is built once here
+    s.bake();
+    double total = timer.get_secs();
+    toolbox_handle_result( t, result );
+    
+    if( !obj_save( options.out, host )){
+        cerr << "unable to save result : " << options.out << endl;
+        return 1;
+    }
+    
+    cerr << endl << "steps : " << step << ( options.has_seed ? "" : " (random seed)" ) << endl;
+    print_timings( cerr, s.getTimings(), total );
+    return 0;
+}
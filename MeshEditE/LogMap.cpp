@@ -9,20 +9,19 @@
 #include <thread>
 #include <queue>
 #include <GEL/HMesh/curvature.h>
-#include <GEL/GLGraphics/ManifoldRenderer.h>
 #include "LogMap.h"
+#include "debug_colors.h"
 #include "HMeshParallelKit.h"
 #include <GEL/Geometry/KDTree.h>
 
 using namespace CGLA;
 using namespace Geometry;
-using namespace GLGraphics;
 using namespace std;
 using namespace HMesh;
 
 ManiPoint LogMap::find_uv(const Vec2f& uv) {
     ManiPoint pt;
-    FaceAttributeVector<int> visited(m.allocated_faces(), 0);
+    SparseFaceAttributeVector<int> visited(0);
     queue<FaceID> Q;
     Q.push(f0);
     while(!Q.empty())
@@ -35,7 +34,7 @@ ManiPoint LogMap::find_uv(const Vec2f& uv) {
             return pt;
         int i=1;
         circulate_face_ccw(m, pt.f, [&](FaceID fn) {
-            if(!visited[fn] && pt.b[i]<=0)
+            if(!visited.contains(fn) && pt.b[i]<=0)
                 Q.push(fn);
             i = (i+1)%3;
         });
@@ -48,7 +47,7 @@ ManiPoint LogMap::find_uv(const Vec2f& uv) {
 
 vector<pair<Vec3d, Vec2f>> LogMap::enumerate() {
     vector<pair<Vec3d, Vec2f>> pts;
-    VertexAttributeVector<int> visited(m.allocated_faces(), 0);
+    SparseVertexAttributeVector<int> visited(0);
     queue<VertexID> Q;
     Q.push(m.walker(f0).vertex());
     while(!Q.empty())
@@ -58,7 +57,7 @@ vector<pair<Vec3d, Vec2f>> LogMap::enumerate() {
         visited[v] = 1;
         pts.push_back(make_pair(m.pos(v), uv_coords(v)));
         circulate_vertex_ccw(m, v, [&](VertexID vn) {
-            if(polar_map[vn][0]<DBL_MAX && !visited[vn])
+            if(polar(vn)[0]<DBL_MAX && !visited.contains(vn))
                 Q.push(vn);
         });
     }
@@ -114,8 +113,8 @@ double LogMap::compute_distance(VertexID s, HalfEdgeID h, double& alpha)
     const Vec3d& Nk = m.pos(v1);
     const Vec3d& Nj = m.pos(v0);
     
-    const double Uk = polar_map[v1][0];
-    const double Uj = polar_map[v0][0];
+    const double Uk = polar(v1)[0];
+    const double Uj = polar(v0)[0];
     
     const double djptsq = sqr_length(Nj-pt);
     const double dkptsq = sqr_length(Nk-pt);
@@ -200,8 +199,8 @@ double LogMap::compute_distance(VertexID s, HalfEdgeID h, double& alpha)
 double LogMap::compute_angle(VertexID s, HalfEdgeID h, double alpha)
 {
     Walker w = m.walker(h);
-    double nkphi = polar_map[w.vertex()][1];
-    double njphi = polar_map[w.opp().vertex()][1];
+    double nkphi = polar(w.vertex())[1];
+    double njphi = polar(w.opp().vertex())[1];
     
     const double diff = fabs(njphi-nkphi);
     
@@ -222,9 +221,8 @@ double LogMap::compute_angle(VertexID s, HalfEdgeID h, double alpha)
     return angle;
 }
 
-LogMap::LogMap(const Manifold& _m, ManiPoint pt, double max_dist): m(_m), f0(pt.f)
+LogMap::LogMap(const Manifold& _m, ManiPoint pt, double max_dist): m(_m), polar_map(Vec2d(DBL_MAX,-1)), f0(pt.f)
 {
-    polar_map = VertexAttributeVector<Vec2d>(m.allocated_vertices(), Vec2d(DBL_MAX,-1));
     priority_queue<pair<double,VertexID>> Q;
     
     
@@ -235,7 +233,7 @@ LogMap::LogMap(const Manifold& _m, ManiPoint pt, double max_dist): m(_m), f0(pt.
         init_vertex(s);
         polar_map[s][0] = 0.0;
         polar_map[s][1] = 0.0;
-        circulate_vertex_ccw(m, s, [&](VertexID v) {Q.push(make_pair(-polar_map[v][0], v));});
+        circulate_vertex_ccw(m, s, [&](VertexID v) {Q.push(make_pair(-polar(v)[0], v));});
     }
     else {
         if(pt.b.min_coord()<0.001) {
@@ -243,7 +241,7 @@ LogMap::LogMap(const Manifold& _m, ManiPoint pt, double max_dist): m(_m), f0(pt.
             pt.b /= pt.b[0]+pt.b[1]+pt.b[2];
         }
         init_face(f0, pt.b);
-        circulate_face_ccw(m, f0, [&](VertexID v) {Q.push(make_pair(-polar_map[v][0], v));});
+        circulate_face_ccw(m, f0, [&](VertexID v) {Q.push(make_pair(-polar(v)[0], v));});
     }
     
     while(!Q.empty())
@@ -258,8 +256,8 @@ LogMap::LogMap(const Manifold& _m, ManiPoint pt, double max_dist): m(_m), f0(pt.
             double new_dist_i=DBL_MAX;
             circulate_vertex_ccw(m, i, [&](Walker w){
                 w = w.next();
-                if(polar_map[w.vertex()][0] < DBL_MAX &&
-                   polar_map[w.opp().vertex()][0] < DBL_MAX) {
+                if(polar(w.vertex())[0] < DBL_MAX &&
+                   polar(w.opp().vertex())[0] < DBL_MAX) {
                     double a;
                     HalfEdgeID h = w.halfedge();
                     double d = compute_distance(i, h , a);
@@ -270,7 +268,7 @@ LogMap::LogMap(const Manifold& _m, ManiPoint pt, double max_dist): m(_m), f0(pt.
                     }
                 }
             });
-            if(polar_map[i][0]/new_dist_i > (1.000000001))
+            if(polar(i)[0]/new_dist_i > (1.000000001))
             {
                 polar_map[i][0] = new_dist_i;
                 polar_map[i][1] = compute_angle(i, he_id, alpha);
@@ -293,7 +291,7 @@ void dist_color_vertices(Manifold& m, HMesh::VertexAttributeVector<int>& vs)
             ManiPoint pt(w.face(), Vec3f(1,0,0));
             LogMap log_map(m, pt, 10.0*avglen);
             for(VertexID v: m.vertices())
-                CheckerBoardRenderer::param[v] = log_map.uv_coords(v) / avglen;
+                debug_vertex_uv( v ) = log_map.uv_coords(v) / avglen;
             break;
         }
     
@@ -407,37 +405,37 @@ void manipoints_to_3D(Manifold& m_in, Manifold& m_ref, VertexAttributeVector<Man
 
 void smooth_geodesic(Manifold& m_in, Manifold& m_ref, VertexAttributeVector<ManiPoint>& ptav, int max_iter, float weight)
 {
-    auto vertex_ids = batch_vertices(m_in);
+    auto vertices = vertex_ids(m_in);
     
     VertexAttributeVector<ManiPoint> ptav_new = ptav;
     
-    auto f = [&](const vector<VertexID>& vids) {
-        for(VertexID v: vids)
-            if(!ptav[v].fixed)
-            {
-                double len=0;
-                circulate_vertex_ccw(m_in, v, [&](HalfEdgeID h){len=max(len,length(m_in,h));});
-                LogMap log_map(m_ref, ptav[v], 3.5 * len);
-                Vec2f uv = log_map.barycentric_uv(ptav[v]);
-                Vec2f new_uv(0);
-                //int cnt=0;
-                double wsum =0;
-                circulate_vertex_ccw(m_in, v, [&](VertexID vn){
-                    Vec2f uvn = log_map.barycentric_uv(ptav[vn]);
-                    if(finite(uvn)) {
-                        double w = 1;//sqr_length(uv-uvn)/sqr_length(m_in.pos(v)-m_in.pos(vn));
-                        wsum += w;
-                        new_uv += w*uvn;
-//                        ++cnt;
-                    }
-                });
-                new_uv = (1-weight) * uv + weight * new_uv/wsum;
-                ptav_new[v] = log_map.find_uv(new_uv);
-            }
+    // the size of the log maps varies a lot, small chunks keep the threads balanced
+    auto f = [&](VertexID v) {
+        if(!ptav[v].fixed)
+        {
+            double len=0;
+            circulate_vertex_ccw(m_in, v, [&](HalfEdgeID h){len=max(len,length(m_in,h));});
+            LogMap log_map(m_ref, ptav[v], 3.5 * len);
+            Vec2f uv = log_map.barycentric_uv(ptav[v]);
+            Vec2f new_uv(0);
+            //int cnt=0;
+            double wsum =0;
+            circulate_vertex_ccw(m_in, v, [&](VertexID vn){
+                Vec2f uvn = log_map.barycentric_uv(ptav[vn]);
+                if(finite(uvn)) {
+                    double w = 1;//sqr_length(uv-uvn)/sqr_length(m_in.pos(v)-m_in.pos(vn));
+                    wsum += w;
+                    new_uv += w*uvn;
+//                    ++cnt;
+                }
+            });
+            new_uv = (1-weight) * uv + weight * new_uv/wsum;
+            ptav_new[v] = log_map.find_uv(new_uv);
+        }
     };
     
     for(auto _ : range(0, max_iter))  {
-        for_each_vertex_parallel(CORES, vertex_ids, f);
+        parallel_for(vertices, f, 16);
         swap(ptav, ptav_new);
         cout << "." << flush;
     }
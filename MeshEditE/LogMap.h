@@ -14,6 +14,7 @@
 #include <GEL/CGLA/Vec2f.h>
 #include <GEL/CGLA/Vec3f.h>
 #include <GEL/HMesh/Manifold.h>
+#include "SparseAttributeVector.h"
 
 struct ManiPoint
 {
@@ -30,19 +31,22 @@ struct ManiPoint
 class LogMap
 {
     const HMesh::Manifold& m;
-    HMesh::VertexAttributeVector<CGLA::Vec2d> polar_map;
+    // only the vertices of the geodesic disc ( and their neighbors ) are stored
+    SparseVertexAttributeVector<CGLA::Vec2d> polar_map;
     HMesh::FaceID f0;
     
     void init_vertex(HMesh::VertexID s);
     void init_face(HMesh::FaceID f, const CGLA::Vec3f& bary);
     double compute_distance(HMesh::VertexID s, HMesh::HalfEdgeID h, double&  alpha);
     double compute_angle(HMesh::VertexID s, HMesh::HalfEdgeID h, double alpha);
+    const CGLA::Vec2d& polar(HMesh::VertexID v) const { return polar_map[v]; }
     
     
 public:
     LogMap(const HMesh::Manifold& m, ManiPoint pt, double max_dist);
-    CGLA::Vec2f uv_coords(HMesh::VertexID v) {
-        return polar_map[v][0] * CGLA::Vec2f(cos(polar_map[v][1]),sin(polar_map[v][1]));
+    CGLA::Vec2f uv_coords(HMesh::VertexID v) const {
+        const CGLA::Vec2d& p = polar(v);
+        return p[0] * CGLA::Vec2f(cos(p[1]),sin(p[1]));
     }
     
     CGLA::Vec3f uv_barycentric(HMesh::FaceID f, const CGLA::Vec2f& uv)
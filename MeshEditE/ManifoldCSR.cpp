@@ -0,0 +1,96 @@
+//
+//  ManifoldCSR.cpp
+//  MeshEditE
+//
+
+#include "ManifoldCSR.h"
+#include "HMeshParallelKit.h"
+
+#include <queue>
+
+using namespace std;
+using namespace CGLA;
+using namespace HMesh;
+
+ManifoldCSR::ManifoldCSR(const Manifold& m): local(m.allocated_vertices(), -1)
+{
+    // breadth first numbering, one component after the other
+    vertex_id.reserve(m.no_vertices());
+    for(VertexID s: m.vertices())
+    {
+        if(local[s] != -1) continue;
+        queue<VertexID> Q;
+        local[s] = static_cast<int>(vertex_id.size());
+        vertex_id.push_back(s);
+        Q.push(s);
+        while(!Q.empty())
+        {
+            VertexID v = Q.front();
+            Q.pop();
+            for(Walker w = m.walker(v); !w.full_circle(); w = w.circulate_vertex_ccw())
+                if(local[w.vertex()] == -1)
+                {
+                    local[w.vertex()] = static_cast<int>(vertex_id.size());
+                    vertex_id.push_back(w.vertex());
+                    Q.push(w.vertex());
+                }
+        }
+    }
+    
+    // every halfedge belongs to exactly one loop
+    HalfEdgeAttributeVector<int> loop(m.allocated_halfedges(), -1);
+    loop_offsets.push_back(0);
+    for(HalfEdgeID h: m.halfedges())
+    {
+        if(loop[h] != -1) continue;
+        int l = static_cast<int>(loop_offsets.size()) - 1;
+        for(Walker w = m.walker(h); !w.full_circle(); w = w.next())
+        {
+            loop[w.halfedge()] = l;
+            loop_vertices.push_back(local[w.vertex()]);
+        }
+        loop_offsets.push_back(static_cast<int>(loop_vertices.size()));
+    }
+    
+    offsets.reserve(no_vertices() + 1);
+    neighbors.reserve(m.no_halfedges());
+    halfedge.reserve(m.no_halfedges());
+    left_loop.reserve(m.no_halfedges());
+    right_loop.reserve(m.no_halfedges());
+    offsets.push_back(0);
+    for(VertexID v: vertex_id)
+    {
+        for(Walker w = m.walker(v); !w.full_circle(); w = w.circulate_vertex_ccw())
+        {
+            neighbors.push_back(local[w.vertex()]);
+            halfedge.push_back(w.halfedge());
+            left_loop.push_back(loop[w.halfedge()]);
+            right_loop.push_back(loop[w.opp().halfedge()]);
+        }
+        offsets.push_back(static_cast<int>(neighbors.size()));
+    }
+}
+
+void ManifoldCSR::gather_positions(const Manifold& m, vector<Vec3d>& pos) const
+{
+    pos.resize(no_vertices());
+    for(size_t i = 0; i < no_vertices(); ++i)
+        pos[i] = m.pos(vertex_id[i]);
+}
+
+void ManifoldCSR::scatter_positions(const vector<Vec3d>& pos, Manifold& m) const
+{
+    for(size_t i = 0; i < no_vertices(); ++i)
+        m.pos(vertex_id[i]) = pos[i];
+}
+
+void ManifoldCSR::loop_centroids(const vector<Vec3d>& pos, vector<Vec3d>& centroids) const
+{
+    centroids.resize(no_loops());
+    parallel_for(size_t(0), no_loops(), [&](size_t l) {
+        Vec3d c(0);
+        for(int k = loop_offsets[l]; k < loop_offsets[l+1]; ++k)
+            c += pos[loop_vertices[k]];
+        centroids[l] = c / double(loop_offsets[l+1] - loop_offsets[l]);
+    });
+}
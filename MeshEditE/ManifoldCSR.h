@@ -0,0 +1,67 @@
+//
+//  ManifoldCSR.h
+//  MeshEditE
+//
+
+#ifndef __MeshEditE__ManifoldCSR__
+#define __MeshEditE__ManifoldCSR__
+
+#include <vector>
+#include <GEL/CGLA/Vec3d.h>
+#include <GEL/HMesh/Manifold.h>
+
+/** Frozen compressed-sparse-row copy of the connectivity of a Manifold, for kernels that iterate
+ many times over an unchanged topology. Vertices are renumbered 0..n-1 in breadth first order so
+ that neighbors are close in memory. The neighbors of vertex i are neighbors[offsets[i]] ..
+ neighbors[offsets[i+1]-1], in the order of circulate_vertex_ccw. Each of these slots is an
+ outgoing halfedge and has the loops ( faces or boundary loops ) on its two sides.
+ The snapshot is invalid as soon as the topology of the mesh changes. */
+class ManifoldCSR {
+public:
+    ManifoldCSR(const HMesh::Manifold& m);
+    
+    size_t no_vertices() const { return vertex_id.size(); }
+    size_t no_slots() const { return neighbors.size(); }
+    size_t no_loops() const { return loop_offsets.size() - 1; }
+    
+    /// local index -> VertexID and back
+    std::vector<HMesh::VertexID>        vertex_id;
+    HMesh::VertexAttributeVector<int>   local;
+    
+    std::vector<int>                    offsets;        // no_vertices() + 1
+    std::vector<int>                    neighbors;      // local index of the neighbor
+    std::vector<HMesh::HalfEdgeID>      halfedge;       // the outgoing halfedge of the slot
+    std::vector<int>                    left_loop;      // loop of the halfedge
+    std::vector<int>                    right_loop;     // loop of its opposite
+    
+    std::vector<int>                    loop_offsets;   // no_loops() + 1
+    std::vector<int>                    loop_vertices;  // local indices, in next() order
+    
+    /// one value per slot, from a halfedge attribute
+    template<typename T>
+    void gather_slots(const HMesh::HalfEdgeAttributeVector<T>& attr, std::vector<T>& values) const {
+        values.resize(no_slots());
+        for(size_t s = 0; s < no_slots(); ++s)
+            values[s] = attr[halfedge[s]];
+    }
+    
+    template<typename T>
+    void gather(const HMesh::VertexAttributeVector<T>& attr, std::vector<T>& values) const {
+        values.resize(no_vertices());
+        for(size_t i = 0; i < no_vertices(); ++i)
+            values[i] = attr[vertex_id[i]];
+    }
+    
+    template<typename T>
+    void scatter(const std::vector<T>& values, HMesh::VertexAttributeVector<T>& attr) const {
+        for(size_t i = 0; i < no_vertices(); ++i)
+            attr[vertex_id[i]] = values[i];
+    }
+    
+    void gather_positions(const HMesh::Manifold& m, std::vector<CGLA::Vec3d>& pos) const;
+    void scatter_positions(const std::vector<CGLA::Vec3d>& pos, HMesh::Manifold& m) const;
+    /// centroid of each loop
+    void loop_centroids(const std::vector<CGLA::Vec3d>& pos, std::vector<CGLA::Vec3d>& centroids) const;
+};
+
+#endif /* defined(__MeshEditE__ManifoldCSR__) */
@@ -20,6 +20,7 @@
 #include <MeshEditE/Procedural/StatefulEngine.h>
 #include <MeshEditE/Procedural/Toolbox.h>
 #include <MeshEditE/Procedural/Helpers/manifold_copy.h>
+#include <MeshEditE/Procedural/Helpers/toolbox_step.h>
 
 #include<MeshEditE/Procedural/Helpers/misc.h>
 
@@ -32,6 +33,7 @@ using namespace Util;
 
 using namespace Procedural::Engines;
 using namespace Procedural;
+using namespace Procedural::Helpers;
 
 #define BASE_NO_TESTS 10
 #define BASE_NO_GLUEINGS 1
@@ -95,6 +97,7 @@ void glue_current( MeshEditor *me, const std::vector< std::string > &args ){
         StatefulEngine &s = StatefulEngine::getCurrentEngine();
 //    s.glueModuleToHost();
     s.actualGlueing();
+    s.bake();
     
 }
 
@@ -117,66 +120,6 @@ void load_toolbox( MeshEditor *me, const std::vector< std::string > &args ){
     t.fromJson( full_path );
 }
 
-struct toolbox_step_result{
-    bool has_next           = true;
-    bool can_glue           = true;
-    bool enough_free_poles  = true;
-    inline bool ok() { return has_next && can_glue && enough_free_poles ; }
-};
-
-toolbox_step_result toolbox_step( Procedural::Toolbox &t, StatefulEngine &s ){
-    toolbox_step_result result;
-    result.has_next = t.hasNext();
-    if( !result.ok() ){ return result; }
-
-    Timer timer;
-    cout << endl << "########################################" << endl << endl;
-    timer.start();
-    Module m = t.getNext();
-    float t0 = timer.get_secs();
-    cout << " adding a piece with "  << m.no_of_glueings << "-valent connection in " << t0 << "s" << endl;
-    
-    s.setModule( m );
-    
-    float t1 = timer.get_secs();
-    
-    cout << "module set in : " << (t1-t0) << endl;
-    
-    result.enough_free_poles   = s.noFreePoles() >= m.no_of_glueings;
-    if( result.enough_free_poles){
-        float t1_1 = timer.get_secs();
-        result.can_glue  = s.testMultipleTransformations();
-        float t2 = timer.get_secs();
-        cout << "configurations tested in in : " << (t2-t1_1) << "s" << endl;
-        
-    }
-    
-    if( result.can_glue && result.enough_free_poles ){
-        float t2_1 = timer.get_secs();
-        s.glueCurrent();
-        float t3 = timer.get_secs();
-        cout << "glueing done in : " << (t3-t2_1) << "s" << endl;
-    }
-    else{
-        t.undoLast();
-    }
-    return result;
-}
-
-void toolbox_handle_result( const Procedural::Toolbox &t, const toolbox_step_result& result ){
-    if( !result.has_next ){
-        cout << "no more pieces " << endl;
-    }
-    if( !result.can_glue ){
-        cout << "cannot find a feasible solution. remaining pieces : " << t.noRemainingPieces() << endl;
-    }
-    if( !result.enough_free_poles ){
-        cout << "there aren't enough free poles. remaining pieces :" << t.noRemainingPieces() << endl;
-    }
-    t.print();
-
-}
-
 void empty_toolbox( MeshEditor *me, const std::vector< std::string > &args ){
     
     Procedural::Toolbox& t = Procedural::Toolbox::getToolboxInstance();
@@ -187,6 +130,7 @@ void empty_toolbox( MeshEditor *me, const std::vector< std::string > &args ){
     while( result.ok() ){
         result = toolbox_step( t, s );
     }
+    s.bake();
     toolbox_handle_result( t, result );
 }
 
@@ -197,6 +141,7 @@ void step_toolbox( MeshEditor *me, const std::vector< std::string > &args ){
     StatefulEngine &s = StatefulEngine::getCurrentEngine();
     
     toolbox_step_result result = toolbox_step( t, s );
+    s.bake();
     if( !result.has_next ){
         cout << "no more pieces " << endl;
     }
@@ -25,6 +25,7 @@ namespace Procedural {
 typedef VertexAttributeVector< Procedural::Geometry::DistanceMetrics >  DistanceVector;
 typedef VertexAttributeVector<double>                                   AngleVector;
 typedef HalfEdgeAttributeVector<double>                                 LengthVector;
+typedef VertexAttributeVector<double>                                   GeodesicVector;
 
         
 // For now it is able to manage only one single connected component.
@@ -38,20 +39,30 @@ struct PolesList
 {
 private:
     vector< VertexID >                  poles;
-    map< VertexID, int >                pole_valency;
-    map< VertexID, int >                pole_age;
+    VertexAttributeVector< int >        pole_slot;      // index in poles, -1 if the vertex is not a pole
+    VertexAttributeVector< int >        pole_valency;
+    VertexAttributeVector< int >        pole_age;
     bool                                is_valid;
     size_t                              no_poles;
     // operations
     int                         const   indexOfPole( VertexID pole )
     {
         assert( IsPole( pole ));
-        auto iter = std::find( poles.begin(), poles.end(), pole );
-        return iter - poles.begin();
+        return pole_slot[pole];
+    }
+    // the last pole takes the place of the removed one
+    void                                RemovePole( VertexID pole )
+    {
+        int      slot = indexOfPole( pole );
+        VertexID last = poles.back();
+        poles[slot]       = last;
+        pole_slot[last]   = slot;
+        poles.pop_back();
+        pole_slot[pole]   = -1;
     }
     
 public:
-    PolesList() { is_valid = false; no_poles = 0; }
+    PolesList() : pole_slot( 0, -1 ) { is_valid = false; no_poles = 0; }
     
     inline vector< VertexID >   const   Poles()         { return poles;     }
     inline bool                 const   IsValid()       { return is_valid;  }
@@ -59,7 +70,7 @@ public:
     inline size_t               const   No_Poles()      { return no_poles;  }
     inline bool                 const   IsPole( VertexID vertex )
     {
-        return std::find( poles.begin(), poles.end(), vertex ) != poles.end();
+        return pole_slot[vertex] >= 0;
     }
            int                  const   PoleValency( VertexID pole )
     {
@@ -69,7 +80,7 @@ public:
     inline int                  const   MeanPoleValency()
     {
         int sum = 0;
-        for( auto v : pole_valency ) { sum += v.second; }
+        for( VertexID pole : poles ) { sum += pole_valency[pole]; }
         return sum/No_Poles();
     }
     inline int                  const   PoleAge( VertexID pole )
@@ -91,6 +102,7 @@ public:
                 if( IsPole( vid ))  { pole_age[vid]++;   }
                 else
                 {
+                    pole_slot[vid] = static_cast<int>( poles.size( ));
                     poles.push_back( vid );
                     pole_age[vid] = 0;
                 }
@@ -98,13 +110,8 @@ public:
             }
             else
             {
-                if( IsPole( vid ))
-                {
-                    // if it was a pole in the last iteration, but it is not anymore
-                    poles.erase( std::find( poles.begin(), poles.end(), vid) );
-                    pole_valency.erase( vid );
-                    pole_age.erase( vid );
-                }
+                // if it was a pole in the last iteration, but it is not anymore
+                if( IsPole( vid )) { RemovePole( vid ); }
             }
         }
         is_valid = true;
@@ -151,9 +158,15 @@ private:
     AngleVector         spine_angles;
     AngleVector         rib_angles;
     LengthVector        edge_lengths;
+    GeodesicVector      pole_geodesic;
+    GeodesicVector      junction_geodesic;
+    GeodesicVector      combined_geodesic;
     double              mean_length;    
     bool                is_valid;
+    bool                with_geodesic;
 public:
+    GeometricInfoContainer() { is_valid = false; with_geodesic = false; }
+    
     inline DistanceVector   const PoleDistance()       { return pole_dist;     }
     inline DistanceVector   const JunctionDistance()   { return junction_dist; }
     inline DistanceVector   const CombinedDistance()   { return combined_dist; }
@@ -163,6 +176,11 @@ public:
     inline AngleVector      const SpineAngles()        { return spine_angles;  }
     inline LengthVector     const EdgeLength()         { return edge_lengths;  }
     inline double           const MeanLength()         { return mean_length;   }
+    // same fields with the spines weighted by their length, only filled if enabled
+    inline GeodesicVector   const PoleGeodesic()       { return pole_geodesic;     }
+    inline GeodesicVector   const JunctionGeodesic()   { return junction_geodesic; }
+    inline GeodesicVector   const CombinedGeodesic()   { return combined_geodesic; }
+    inline void                   SetGeodesic( bool enabled ) { with_geodesic = enabled; is_valid = false; }
     
     inline bool             const IsValid()             { return is_valid;  }
     inline void                   Invalidate()          { is_valid = false; }
@@ -179,9 +197,9 @@ public:
         Procedural::Geometry::dihedral_angles                   ( *mesh, edgeInfo.edgeInfo(), spine_angles,  SPINE   );
         Procedural::Geometry::dihedral_angles                   ( *mesh, edgeInfo.edgeInfo(), rib_angles,    RIB     );
 
-        Procedural::Geometry::distance_from_poles               ( *mesh, edgeInfo.edgeInfo(), pole_dist,     false   );
-        Procedural::Geometry::distance_from_junctions           ( *mesh, edgeInfo.edgeInfo(), junction_dist, false   );
-        Procedural::Geometry::distance_from_poles_and_junctions ( *mesh, edgeInfo.edgeInfo(), combined_dist, false   );
+        Procedural::Geometry::distance_fields                   ( *mesh, edgeInfo.edgeInfo(), pole_dist, junction_dist, combined_dist );
+        if( with_geodesic )
+            Procedural::Geometry::geodesic_distance_fields      ( *mesh, edgeInfo.edgeInfo(), pole_geodesic, junction_geodesic, combined_geodesic );
         UpdateEdgeLengths ( *mesh );
         is_valid = true;
     }
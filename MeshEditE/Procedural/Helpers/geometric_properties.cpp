@@ -8,16 +8,17 @@
 
 #include "geometric_properties.h"
 #include "polarize.h"
-#include <GEL/GLGraphics/ManifoldRenderer.h>
+#include <MeshEditE/debug_colors.h>
 #include <MeshEditE/Procedural/Helpers/structural_helpers.h>
 #include <queue>
+#include <deque>
+#include <limits>
 #include "Test.h"
 #include "math.h"
 
 using namespace CGLA;
 using namespace std;
 using namespace HMesh;
-using namespace GLGraphics;
 using namespace Procedural::Structure;
 
 namespace Procedural{
@@ -223,354 +224,258 @@ double dihedral_angle ( Vec3d a, Vec3d b, Vec3d c, Vec3d d )
     return limit_cs;
 }
         
-void distance_from_poles ( Manifold& m, const HalfEdgeAttributeVector<EdgeInfo> edge_info,
-                           VertexAttributeVector<DistanceMetrics> &distances, bool debug_colors )
+/*=========================================================================*
+ *                     DISTANCE FIELDS                                     *
+ *=========================================================================*/
+        
+// vertices that cannot be reached from any source, e.g. junction distances on a mesh without junctions
+static const int    UNREACHED_HOPS      = numeric_limits<int>::max();
+static const double UNREACHED_LENGTH    = numeric_limits<double>::max();
+
+static void pole_sources( Manifold& m, vector< VertexID > &sources )
 {
-    // AS START, USE ONLY THE HOP METRIC
-    int max_dist = numeric_limits<int>::min();
-    std::queue< VertexID > poles;
-    std::map< VertexID, DistanceMetrics > ds;
-    // put all the poles into a pole queue
-    for( auto vit = m.vertices().begin(); vit != m.vertices().end(); ++vit )
+    for( VertexID v : m.vertices( ))
     {
-        if( is_pole( m, *vit )) poles.push( *vit );
+        if( is_pole( m, v )) sources.push_back( v );
     }
-    // while the queue is not empty
-    while( !poles.empty( ))
+}
+
+static void junction_sources( Manifold& m, const HalfEdgeAttributeVector<EdgeInfo> &edge_info,
+                              vector< VertexID > &sources )
+{
+    for( VertexID v : m.vertices( ))
     {
-    //  set current_distance to 0
-        int current_distance = 0;
-    //  extract a pole from the queue.
-        VertexID curr = poles.front();
-        poles.pop();
-        //  set 0 the distance
-        ds[curr] = current_distance;
-        //  current_distance++
-        current_distance++;
-    //  take the pole 1 ring - and set the distance to current_distance.
-        HalfEdgeID  he_helper       = m.walker( curr ).halfedge();
-        VertexID    pole_neighbor   = m.walker( curr ).vertex();
-        //  while the representative vertex of the next ring is not a pole
-        while ( !is_pole( m, pole_neighbor ))
+        Walker w = m.walker( v );
+        for( ; !w.full_circle(); w = w.circulate_vertex_ccw( ))
         {
-            HalfEdgeID ring_he = get_first_rib_edge( m, pole_neighbor, edge_info, true );
-            vector< VertexID >      ring_vs;
-            vector< HalfEdgeID >    ring_hes;
-            ring_vertices_and_halfedges( m, ring_he, ring_vs, ring_hes );
-            for( auto v : ring_vs )
-            {
-                //      if the distance for that ring of vertex is not set || is smaller than current_distance
-                //          set the distance to current_distance
-                if( ds.count(v) == 0 )
-                {
-                    ds[v] = current_distance;
-                }
-                if( ds.count(v) >  0 )
-                {
-                    if(  ds[v] > current_distance )
-                    {
-                        ds[v] = current_distance;
-                    }
-                }
-            }
-            current_distance++;
-    //      move to the next ring
-            he_helper       = m.walker( he_helper ).next().opp().next().halfedge();
-            pole_neighbor   = m.walker( he_helper ).vertex();
-            
+            if( edge_info[w.halfedge()].is_junction( )) { sources.push_back( v ); break; }
         }
     }
+}
 
-    // vertices in some strange configurations are not reacheable with this procedure
-    // fix that starting from those vertices, follow each of their edge chain
-    // until the circle is clsoed or a pole is found.
-    // a pole should be always found.
-    for( auto vit = m.vertices().begin(); vit != m.vertices().end(); ++vit )
+// multi-source 0-1 BFS over the rib/spine graph. Moving along a rib costs nothing, so each
+// rib loop gets a single value, moving along a spine costs one hop.
+// sources[k] seeds hops[k], the no_fields fields are computed in the same traversal : the items
+// of the queue are ( vertex, field ) pairs and each of them relaxes its own field only
+static void hop_distance_fields( Manifold& m, const HalfEdgeAttributeVector<EdgeInfo> &edge_info, size_t no_fields,
+                                 const vector< VertexID > *sources, VertexAttributeVector<int> *hops )
+{
+    typedef pair< VertexID, size_t > VertexField;
+    
+    for( size_t k = 0; k < no_fields; ++k )
     {
-        // take each vertex that does not have distance set
-        if ( !(ds.count( *vit ) > 0 ))
+        for( VertexID v : m.vertices( )) hops[k][v] = UNREACHED_HOPS;
+    }
+    
+    deque< VertexField > front;
+    for( size_t k = 0; k < no_fields; ++k )
+    {
+        for( VertexID s : sources[k] )
         {
-            Walker w = m.walker(*vit);
-            for( ; !w.full_circle(); w = w.circulate_vertex_ccw())
-            {
-                if( edge_info[w.halfedge()].is_rib( )) continue;
-                Walker lw = m.walker(w.halfedge());
-                int current_distance = 0;
-                while ( !lw.full_circle( ) && !is_pole(m, lw.vertex()))
-                {
-                    lw = lw.next().opp().next();
-                    current_distance++;
-                }
-                if ( is_pole(m, lw.vertex( )))
-                {
-                    if( !(ds.count( *vit ) > 0 ))
-                        ds[*vit] = current_distance;
-                    else
-                    {
-                        if( ds[*vit] > current_distance )
-                        {
-                            ds[*vit] = current_distance;
-                        }
-                    }
-                }
-            }
+            hops[k][s] = 0;
+            front.push_back( make_pair( s, k ));
         }
-        if( ds[*vit] > max_dist ) max_dist = ds[*vit];
-        distances[*vit] = ds[*vit];
     }
     
-    if( debug_colors )
+    while( !front.empty( ))
     {
-        // debug - useful
-        for( auto vit = m.vertices().begin(); vit != m.vertices().end(); ++vit )
+        VertexField item = front.front();
+        front.pop_front();
+        VertexAttributeVector<int>& field = hops[item.second];
+        int                         d     = field[item.first];
+        
+        Walker w = m.walker( item.first );
+        for( ; !w.full_circle(); w = w.circulate_vertex_ccw( ))
         {
-            assert( m.in_use( *vit ));
-            assert( ds.count( *vit ) > 0 );
-            
-            if( is_pole(m, *vit )) assert( ds[*vit] == 0 );
+            VertexID    u       = w.vertex();
+            bool        on_rib  = edge_info[w.halfedge()].is_rib();
+            int         du      = on_rib ? d : d + 1;
+            if( du >= field[u] ) continue;
             
-
-            Vec3f color = color_ramp(ds[*vit], max_dist);
-            DebugRenderer::vertex_colors[*vit] = color;
-            Walker w = m.walker(*vit);
-            for(; !w.full_circle(); w = w.circulate_vertex_ccw())
-            {
-                if( edge_info[w.halfedge()].is_rib() )
-                {
-                    DebugRenderer::edge_colors[w.halfedge()]        = color;
-                    DebugRenderer::edge_colors[w.opp().halfedge()]  = color;
-                }
-            }
-            //
+            field[u] = du;
+            if( on_rib ) front.push_front( make_pair( u, item.second ));
+            else         front.push_back( make_pair( u, item.second ));
         }
     }
-    cout << "finito";
 }
-        
-        
-void distance_from_junctions ( Manifold& m, const HalfEdgeAttributeVector<EdgeInfo> edge_info,
-                                 VertexAttributeVector<DistanceMetrics> &distances, bool debug_colors )
+
+// same as hop_distance_fields, but spines cost their length ( Dijkstra )
+static void length_distance_fields( Manifold& m, const HalfEdgeAttributeVector<EdgeInfo> &edge_info, size_t no_fields,
+                                    const vector< VertexID > *sources, VertexAttributeVector<double> *lengths )
 {
-    // AS START, USE ONLY THE HOP METRIC
-    int max_dist = numeric_limits<int>::min();
-    std::queue< VertexID > poles;
-    std::map< VertexID, DistanceMetrics > ds;
-    bool has_junctions = false;
+    struct Item{
+        double      dist;
+        VertexID    v;
+        size_t      field;
+        bool operator>( const Item& other ) const { return dist > other.dist; }
+    };
     
-    for( auto heid : m.halfedges())
+    for( size_t k = 0; k < no_fields; ++k )
     {
-        int current_distance = 0;
-        // skip the non junction edges
-        if( !( edge_info[heid].is_junction( ))) continue;
-        has_junctions = true;
-        
-        Walker w = m.walker( heid );
-        if ( ds.count(w.vertex()) == 0 )
-            ds[w.vertex()] = current_distance;
-        
-        do{
-            current_distance++;
-            auto vid = w.next().vertex();
-            if ( ds.count( vid ) == 0 )
-                ds[ vid ] = current_distance;
-            else
-            {
-                if( ds[vid] > current_distance )
-                    ds[vid] = current_distance;
-            }
-            // move to the next rib edege loop
-            w = w.next().next().opp();
-            
-        }while( !is_pole( m, w.next().vertex( ))
-             && !edge_info[ w.next().next().halfedge() ].is_junction() );
-        
-        if( is_pole(m, w.next().vertex( )))
-            ds[ w.next().vertex( ) ] = current_distance;
+        for( VertexID v : m.vertices( )) lengths[k][v] = UNREACHED_LENGTH;
     }
     
-    // all the following stuff is meaningful only if the mesh has junctions
-    if(has_junctions)
+    priority_queue< Item, vector< Item >, greater< Item > > front;
+    for( size_t k = 0; k < no_fields; ++k )
     {
-        // debug
-        for( auto vit = m.vertices().begin(); vit != m.vertices().end(); ++vit )
+        for( VertexID s : sources[k] )
         {
-            if ( !(ds.count( *vit ) > 0 ))
-            {
-                Walker w = m.walker(*vit);
-                for(; !w.full_circle(); w = w.circulate_vertex_ccw())
-                    DebugRenderer::face_colors[w.face()] = Vec3f( 1.0, 1.0, 0.0);
-            }
-            else
-            {
-                max_dist = max_dist < ds[*vit] ? ds[*vit] : max_dist;
-            }
-            distances[*vit] = ds[*vit];
+            lengths[k][s] = 0.0;
+            front.push( Item{ 0.0, s, k });
         }
-        //
-
-        if(debug_colors)
+    }
+    
+    while( !front.empty( ))
+    {
+        Item item = front.top();
+        front.pop();
+        VertexAttributeVector<double>& field = lengths[item.field];
+        if( item.dist > field[item.v] ) continue;     // stale entry
+        
+        Walker w = m.walker( item.v );
+        for( ; !w.full_circle(); w = w.circulate_vertex_ccw( ))
         {
-            Vec3f blue( 0.0, 0.0, 1.0 );
-
-            for( auto vit = m.vertices().begin(); vit != m.vertices().end(); ++vit )
-            {
-                if ( *vit == InvalidVertexID ) continue;
-                assert( m.in_use( *vit ));
-                assert( ds.count( *vit ) > 0 );
-                
-                Vec3f color = color_ramp(ds[*vit], max_dist);
-                DebugRenderer::vertex_colors[*vit] = color;
-                Walker w = m.walker(*vit);
-                for(; !w.full_circle(); w = w.circulate_vertex_ccw())
-                {
-                    if( edge_info[w.halfedge()].is_rib() && !edge_info[w.halfedge()].is_junction() )
-                    {
-                        DebugRenderer::edge_colors[w.halfedge()]        = color;
-                        DebugRenderer::edge_colors[w.opp().halfedge()]  = color;
-                    }
-                    if( edge_info[w.halfedge()].is_junction() )
-                    {
-                        DebugRenderer::edge_colors[w.halfedge()]        = blue;
-                        DebugRenderer::edge_colors[w.opp().halfedge()]  = blue;
-                    }
-                }
-            }
+            VertexID    u   = w.vertex();
+            double      du  = item.dist;
+            if( !edge_info[w.halfedge()].is_rib( )) du += length( m, w.halfedge( ));
+            if( du >= field[u] ) continue;
+            
+            field[u] = du;
+            front.push( Item{ du, u, item.field });
         }
     }
 }
-        
-void distance_from_poles_and_junctions ( Manifold& m,
-                                         const HalfEdgeAttributeVector<EdgeInfo> edge_info,
-                                         VertexAttributeVector<DistanceMetrics> &distances,
-                                         bool debug_colors)
+
+// unreached vertices get 0, as the ring walks left them
+static int finalize_hops( Manifold& m, VertexAttributeVector<int> &hops,
+                          VertexAttributeVector<DistanceMetrics> &distances )
 {
-    std::map< VertexID, DistanceMetrics > ds;
-    
-    // get distances from junctions
-    //
-    for( auto heid : m.halfedges())
+    int max_dist = numeric_limits<int>::min();
+    for( VertexID v : m.vertices( ))
     {
-        int current_distance = 0;
-        // skip the non junction edges
-        if( !(edge_info[heid].is_junction( ))) continue;
-        
-        Walker w = m.walker( heid );
-        if ( ds.count(w.vertex()) == 0 )
-            ds[w.vertex()] = current_distance;
-        
-        do{
-            current_distance++;
-            auto vid = w.next().vertex();
-            if ( ds.count( vid ) == 0 )
-                ds[ vid ] = current_distance;
-            else
-            {
-                if( ds[vid] > current_distance )
-                    ds[vid] = current_distance;
-            }
-            w = w.next().next().opp();
-        }while( !is_pole(m, w.next().vertex())
-               && !edge_info[ w.next().next().halfedge()].is_junction() );
-        
-        if( is_pole(m, w.next().vertex( )))
-            ds[ w.next().vertex( ) ] = current_distance;
+        int d = ( hops[v] == UNREACHED_HOPS ) ? 0 : hops[v];
+        distances[v] = d;
+        if( d > max_dist ) max_dist = d;
     }
+    return max_dist;
+}
+
+static void color_distances( Manifold& m, const HalfEdgeAttributeVector<EdgeInfo> &edge_info,
+                             VertexAttributeVector<DistanceMetrics> &distances, int max_dist, bool color_junctions )
+{
+    Vec3f blue( 0.0, 0.0, 1.0 );
     
-    // add distances from poles
-    //
-    for( auto vit = m.vertices().begin(); vit != m.vertices().end(); ++vit )
+    for( VertexID v : m.vertices( ))
     {
-        if( !is_pole( m, *vit )) continue;
-        VertexID curr = *vit;
-        
-        //  set current_distance to 0
-        int current_distance = 0;
-        
-        //  set 0 the distance
-        ds[curr] = current_distance;
-        //  current_distance++
-        current_distance++;
-        //  take the pole 1 ring - and set the distance to current_distance.
-        HalfEdgeID  he_helper       = m.walker( curr ).halfedge();
-        VertexID    pole_neighbor   = m.walker( curr ).vertex();
-        //  while the representative vertex of the next ring is not a pole
-        while ( !is_pole( m, pole_neighbor ))
+        assert( m.in_use( v ));
+        
+        Vec3f color = color_ramp( distances[v], max_dist );
+        debug_vertex_color( v ) = color;
+        Walker w = m.walker( v );
+        for(; !w.full_circle(); w = w.circulate_vertex_ccw())
         {
-            HalfEdgeID ring_he = get_first_rib_edge( m, pole_neighbor, edge_info, true );
-            vector< VertexID >      ring_vs;
-            vector< HalfEdgeID >    ring_hes;
-            ring_vertices_and_halfedges( m, ring_he, ring_vs, ring_hes );
-            for( auto v : ring_vs )
+            bool is_junction = edge_info[w.halfedge()].is_junction();
+            if( edge_info[w.halfedge()].is_rib() && !( color_junctions && is_junction ))
             {
-                //      if the distance for that ring of vertex is not set || is smaller than current_distance
-                //          set the distance to current_distance
-                if( ds.count(v) == 0 )
-                {
-                    ds[v] = current_distance;
-                }
-                if( ds.count(v) >  0 )
-                {
-                    if(  ds[v] > current_distance )
-                    {
-                        ds[v] = current_distance;
-                    }
-                }
+                debug_edge_color( w.halfedge() )        = color;
+                debug_edge_color( w.opp().halfedge() )  = color;
+            }
+            if( color_junctions && is_junction )
+            {
+                debug_edge_color( w.halfedge() )        = blue;
+                debug_edge_color( w.opp().halfedge() )  = blue;
             }
-            current_distance++;
-            //      move to the next ring
-            he_helper       = m.walker( he_helper ).next().opp().next().halfedge();
-            pole_neighbor   = m.walker( he_helper ).vertex();
-            
         }
     }
-    int max_dist = numeric_limits<int>::min();
+}
+        
+void distance_fields ( Manifold& m, const HalfEdgeAttributeVector<EdgeInfo> &edge_info,
+                       VertexAttributeVector<DistanceMetrics> &from_poles,
+                       VertexAttributeVector<DistanceMetrics> &from_junctions,
+                       VertexAttributeVector<DistanceMetrics> &combined )
+{
+    vector< VertexID >          sources[2];
+    VertexAttributeVector<int>  hops[2];
     
-    // debug
-    for( auto vit = m.vertices().begin(); vit != m.vertices().end(); ++vit )
+    pole_sources( m, sources[0] );
+    junction_sources( m, edge_info, sources[1] );
+    hop_distance_fields( m, edge_info, 2, sources, hops );
+    
+    for( VertexID v : m.vertices( ))
     {
-        if ( !(ds.count( *vit ) > 0 ))
-        {
-            Walker w = m.walker(*vit);
-            for(; !w.full_circle(); w = w.circulate_vertex_ccw())
-                DebugRenderer::face_colors[w.face()] = Vec3f( 1.0, 1.0, 0.0);
-        }
-        else
-        {
-            max_dist = max_dist < ds[*vit] ? ds[*vit] : max_dist;
-        }
-        distances[*vit] = ds[*vit];
-        
+        int p = hops[0][v], j = hops[1][v];
+        from_poles[v]       = ( p == UNREACHED_HOPS ) ? 0 : p;
+        from_junctions[v]   = ( j == UNREACHED_HOPS ) ? 0 : j;
+        combined[v]         = ( min( p, j ) == UNREACHED_HOPS ) ? 0 : min( p, j );
     }
+}
+        
+void geodesic_distance_fields ( Manifold& m, const HalfEdgeAttributeVector<EdgeInfo> &edge_info,
+                                VertexAttributeVector<double> &from_poles,
+                                VertexAttributeVector<double> &from_junctions,
+                                VertexAttributeVector<double> &combined )
+{
+    vector< VertexID >              sources[2];
+    VertexAttributeVector<double>   lengths[2];
+    
+    pole_sources( m, sources[0] );
+    junction_sources( m, edge_info, sources[1] );
+    length_distance_fields( m, edge_info, 2, sources, lengths );
     
-    if( debug_colors )
+    for( VertexID v : m.vertices( ))
     {
-        Vec3f blue( 0.0, 0.0, 1.0 );
-        
-        for( auto vit = m.vertices().begin(); vit != m.vertices().end(); ++vit )
-        {
-            assert( m.in_use( *vit ));
-            assert( ds.count( *vit ) > 0 );
-            
-            Vec3f color = color_ramp(ds[*vit], max_dist);
-            DebugRenderer::vertex_colors[*vit] = color;
-            Walker w = m.walker(*vit);
-            for(; !w.full_circle(); w = w.circulate_vertex_ccw())
-            {
-                if( edge_info[w.halfedge()].is_rib() && !edge_info[w.halfedge()].is_junction() )
-                {
-                    DebugRenderer::edge_colors[w.halfedge()]        = color;
-                    DebugRenderer::edge_colors[w.opp().halfedge()]  = color;
-                }
-                if( edge_info[w.halfedge()].is_junction() )
-                {
-                    DebugRenderer::edge_colors[w.halfedge()]        = blue;
-                    DebugRenderer::edge_colors[w.opp().halfedge()]  = blue;
-                }
-            }
-        }
+        from_poles[v]       = lengths[0][v];
+        from_junctions[v]   = lengths[1][v];
+        combined[v]         = min( from_poles[v], from_junctions[v] );
     }
 }
         
+void distance_from_poles ( Manifold& m, const HalfEdgeAttributeVector<EdgeInfo> edge_info,
+                           VertexAttributeVector<DistanceMetrics> &distances, bool debug_colors )
+{
+    vector< VertexID >          sources;
+    VertexAttributeVector<int>  hops;
+    
+    pole_sources( m, sources );
+    hop_distance_fields( m, edge_info, 1, &sources, &hops );
+    int max_dist = finalize_hops( m, hops, distances );
+    
+    if( debug_colors ) color_distances( m, edge_info, distances, max_dist, false );
+}
+        
+        
+void distance_from_junctions ( Manifold& m, const HalfEdgeAttributeVector<EdgeInfo> edge_info,
+                                 VertexAttributeVector<DistanceMetrics> &distances, bool debug_colors )
+{
+    vector< VertexID >          sources;
+    VertexAttributeVector<int>  hops;
+    
+    // meaningful only if the mesh has junctions
+    junction_sources( m, edge_info, sources );
+    if( sources.empty( )) return;
+    
+    hop_distance_fields( m, edge_info, 1, &sources, &hops );
+    int max_dist = finalize_hops( m, hops, distances );
+    
+    if( debug_colors ) color_distances( m, edge_info, distances, max_dist, true );
+}
+        
+void distance_from_poles_and_junctions ( Manifold& m,
+                                         const HalfEdgeAttributeVector<EdgeInfo> edge_info,
+                                         VertexAttributeVector<DistanceMetrics> &distances,
+                                         bool debug_colors)
+{
+    vector< VertexID >          sources;
+    VertexAttributeVector<int>  hops;
+    
+    pole_sources( m, sources );
+    junction_sources( m, edge_info, sources );
+    hop_distance_fields( m, edge_info, 1, &sources, &hops );
+    int max_dist = finalize_hops( m, hops, distances );
+    
+    if( debug_colors ) color_distances( m, edge_info, distances, max_dist, true );
+}
+        
 Vec3f get_angle_color( double coseno )
 {
     return color_ramp2( (int)( ( 1.0 + coseno ) * 20.0 ) , 20 );
@@ -622,11 +527,11 @@ void dihedral_angles ( Manifold& m, HalfEdgeAttributeVector<EdgeInfo> edge_info,
         
         angles[a] = cosv;
         
-        DebugRenderer::edge_colors[he1]                             = get_angle_color( cos1 );
-        DebugRenderer::edge_colors[m.walker(he1).opp().halfedge()]  = get_angle_color( cos1 );
-        DebugRenderer::edge_colors[he2]                             = get_angle_color( cos2 );
-        DebugRenderer::edge_colors[m.walker(he2).opp().halfedge()]  = get_angle_color( cos2 );
-        DebugRenderer::vertex_colors[a]                             = get_angle_color( cosv );
+        debug_edge_color( he1 )                             = get_angle_color( cos1 );
+        debug_edge_color( m.walker(he1).opp().halfedge() )  = get_angle_color( cos1 );
+        debug_edge_color( he2 )                             = get_angle_color( cos2 );
+        debug_edge_color( m.walker(he2).opp().halfedge() )  = get_angle_color( cos2 );
+        debug_vertex_color( a )                             = get_angle_color( cosv );
     }
 }
         
@@ -639,7 +544,7 @@ void dihedral_angles ( Manifold& m, const HalfEdgeAttributeVector<EdgeInfo> edge
     for( auto vid : m.vertices( ))
     {
         angles[vid] = ( rib_angles[vid] + spine_angles[vid] ) / 2.0;
-        DebugRenderer::vertex_colors[vid] = get_angle_color( angles[vid] );
+        debug_vertex_color( vid ) = get_angle_color( angles[vid] );
     }
     
 }
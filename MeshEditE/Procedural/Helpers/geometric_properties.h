@@ -43,6 +43,18 @@ bool            is_neighbor_of_pole( HMesh::Manifold& m, HMesh::VertexID v);
 bool            is_2_neighbor_of_pole( HMesh::Manifold& m, HMesh::VertexID v );
 
 // must have calld label junction on edge_info
+// distances measured along spines, moving along a rib is free. Both fields come from a single
+// traversal, combined is the minimum of the two. Unreachable vertices get 0
+void            distance_fields( HMesh::Manifold& m, const HMesh::HalfEdgeAttributeVector<EdgeInfo> &edge_info,
+                                 HMesh::VertexAttributeVector<DistanceMetrics> &from_poles,
+                                 HMesh::VertexAttributeVector<DistanceMetrics> &from_junctions,
+                                 HMesh::VertexAttributeVector<DistanceMetrics> &combined );
+// same as above, spines are weighted with their length. Unreachable vertices get DBL_MAX
+void            geodesic_distance_fields( HMesh::Manifold& m, const HMesh::HalfEdgeAttributeVector<EdgeInfo> &edge_info,
+                                          HMesh::VertexAttributeVector<double> &from_poles,
+                                          HMesh::VertexAttributeVector<double> &from_junctions,
+                                          HMesh::VertexAttributeVector<double> &combined );
+
 void            distance_from_poles( HMesh::Manifold& m, HMesh::HalfEdgeAttributeVector<EdgeInfo> edge_info,
                                      HMesh::VertexAttributeVector<DistanceMetrics> &distances, bool debug_colors = true );
 
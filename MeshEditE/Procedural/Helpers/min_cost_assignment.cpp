@@ -0,0 +1,70 @@
+//
+//  min_cost_assignment.cpp
+//  MeshEditE
+//
+
+#include "min_cost_assignment.h"
+
+#include <limits>
+
+using namespace std;
+
+namespace Procedural{
+    namespace Helpers{
+
+void AssignmentSolver::reset( size_t no_rows, size_t no_cols, double fill ){
+    assert( no_rows <= no_cols );
+    rows = no_rows;
+    cols = no_cols;
+    a.assign( rows * cols, fill );
+}
+
+// rows and columns are 1-based in the potentials, p[0] and column 0 are the sentinel
+double AssignmentSolver::solve( vector< int >& row_to_col ){
+    const double INF = numeric_limits< double >::infinity();
+    u.assign( rows + 1, 0.0 );
+    v.assign( cols + 1, 0.0 );
+    p.assign( cols + 1, 0 );
+    way.assign( cols + 1, 0 );
+
+    for( size_t i = 1; i <= rows; ++i ){
+        p[0]        = static_cast< int >( i );
+        size_t j0   = 0;
+        minv.assign( cols + 1, INF );
+        used.assign( cols + 1, 0 );
+        // grow an alternating tree from row i until it reaches a free column
+        do{
+            used[j0]    = 1;
+            size_t i0   = p[j0], j1 = 0;
+            double delta = INF;
+            for( size_t j = 1; j <= cols; ++j ){
+                if( used[j] ){ continue; }
+                double cur = a[( i0 - 1 ) * cols + ( j - 1 )] - u[i0] - v[j];
+                if( cur < minv[j] ){ minv[j] = cur; way[j] = static_cast< int >( j0 ); }
+                if( minv[j] < delta ){ delta = minv[j]; j1 = j; }
+            }
+            for( size_t j = 0; j <= cols; ++j ){
+                if( used[j] ){ u[p[j]] += delta; v[j] -= delta; }
+                else         { minv[j] -= delta; }
+            }
+            j0 = j1;
+        } while( p[j0] != 0 );
+        // augment along the tree
+        do{
+            size_t j1   = way[j0];
+            p[j0]       = p[j1];
+            j0          = j1;
+        } while( j0 != 0 );
+    }
+
+    row_to_col.assign( rows, -1 );
+    double total = 0.0;
+    for( size_t j = 1; j <= cols; ++j ){
+        if( p[j] == 0 ){ continue; }
+        row_to_col[p[j] - 1] = static_cast< int >( j - 1 );
+        total += a[( p[j] - 1 ) * cols + ( j - 1 )];
+    }
+    return total;
+}
+
+}}
@@ -0,0 +1,37 @@
+//
+//  min_cost_assignment.h
+//  MeshEditE
+//
+
+#ifndef __MeshEditE__min_cost_assignment__
+#define __MeshEditE__min_cost_assignment__
+
+#include <stdio.h>
+#include <vector>
+#include <cassert>
+
+namespace Procedural{
+    namespace Helpers{
+
+/// minimum cost assignment of each row to a distinct column ( Hungarian method with potentials,
+/// O( rows^2 cols ) ), it needs rows <= cols. The buffers are kept between calls, a solver
+/// reused for problems of similar size does not allocate.
+class AssignmentSolver{
+public:
+    // sets every cost to fill
+    void            reset( size_t no_rows, size_t no_cols, double fill );
+    inline double&  cost( size_t r, size_t c ){ assert( r < rows && c < cols ); return a[r * cols + c]; }
+    // row_to_col[r] is the column assigned to row r, returns the total cost
+    double          solve( std::vector< int >& row_to_col );
+
+private:
+    size_t                  rows = 0, cols = 0;
+    std::vector< double >   a;
+    std::vector< double >   u, v, minv;
+    std::vector< int >      p, way;
+    std::vector< char >     used;
+};
+
+}}
+
+#endif /* defined(__MeshEditE__min_cost_assignment__) */
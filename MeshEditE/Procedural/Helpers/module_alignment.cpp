@@ -11,7 +11,7 @@
 #include <unordered_set>
 #include <random>
 
-#include <GEL/GLGraphics/ManifoldRenderer.h>
+#include <MeshEditE/debug_colors.h>
 
 #include <polarize.h>
 #include <MeshEditE/Procedural/Helpers/geometric_properties.h>
@@ -44,6 +44,15 @@ void build_manifold_kdtree( Manifold& m, const set< VertexID > &selected, kd_tre
     tree.build();    
 }
 
+void build_manifold_kdtree( Manifold& m, const vector< VertexID > &selected, kd_tree &tree)
+{
+    for( VertexID v : selected )
+    {
+        tree.insert( m.pos(v), v);
+    }
+    tree.build();
+}
+
 /// builds a pseudo-random transformation Tr that brings the module
 /// in a possibly collision-free position outside the host's bounding sphere
 void generate_random_transform( HMesh::Manifold &m, const set<VertexID> &host_vs,
@@ -175,8 +184,8 @@ void apply_optimal_alignment( Manifold &m, const set<VertexID> &module_vs, match
         Vec3f red( 1, 0, 0 ), blue(0, 1, 0);
         
         // use debug colors to exploit the matched vertices
-        GLGraphics::DebugRenderer::vertex_colors[m.first] = red;
-        GLGraphics::DebugRenderer::vertex_colors[m.second] = blue;
+        debug_vertex_color( m.first ) = red;
+        debug_vertex_color( m.second ) = blue;
 
         // TODO
         // do that fucking dimensionality constraint
@@ -79,7 +79,6 @@ namespace Procedural {
             CMatrix S = X * W * Y_t;
             // it should be 3 * 3
             assert( S.Rows() == 3 && S.Cols() == 3 );
-            cout << S.Rows() << " # " << S.Cols() << endl;
             // ask if V is transposed or not, but I guess it is
             // given the signature of the method it seems to be not.
             CMatrix U, Sigma, V;
@@ -0,0 +1,83 @@
+//
+//  toolbox_step.cpp
+//  MeshEditE
+//
+//  Moved out of ConsoleFuncs/engine_console_funcs.cpp so that pam_generate can share it.
+//
+//  Created by Francesco Usai on 08/04/15.
+//  Copyright (c) 2015 J. Andreas Bærentzen. All rights reserved.
+//
+
+#include "toolbox_step.h"
+
+#include <iostream>
+
+#include <GEL/Util/Timer.h>
+
+using namespace std;
+using namespace Util;
+
+using namespace Procedural::Engines;
+
+namespace Procedural{
+    namespace Helpers{
+
+toolbox_step_result toolbox_step( Procedural::Toolbox &t, StatefulEngine &s ){
+    toolbox_step_result result;
+    result.has_next = t.hasNext();
+    if( !result.ok() ){ return result; }
+
+    Timer timer;
+    cout << endl << "########################################" << endl << endl;
+    timer.start();
+    // the engine copies the module before transforming it, the toolbox one is left untouched
+    Module& m = t.getNext();
+    float t0 = timer.get_secs();
+    cout << " adding a piece with "  << m.no_of_glueings << "-valent connection in " << t0 << "s" << endl;
+    
+    s.setModule( m );
+    
+    float t1 = timer.get_secs();
+    
+    cout << "module set in : " << (t1-t0) << endl;
+    
+    result.enough_free_poles   = s.noFreePoles() >= m.no_of_glueings;
+    if( result.enough_free_poles){
+        float t1_1 = timer.get_secs();
+        result.can_glue  = s.testMultipleTransformations();
+        float t2 = timer.get_secs();
+        cout << "configurations tested in in : " << (t2-t1_1) << "s" << endl;
+        
+    }
+    else{
+        // testMultipleTransformations was not called, the engine must be reset here
+        s.consolidate();
+    }
+    
+    if( result.can_glue && result.enough_free_poles ){
+        float t2_1 = timer.get_secs();
+        s.glueCurrent();
+        float t3 = timer.get_secs();
+        cout << "glueing done in : " << (t3-t2_1) << "s" << endl;
+    }
+    else{
+        t.undoLast();
+    }
+    return result;
+}
+
+void toolbox_handle_result( const Procedural::Toolbox &t, const toolbox_step_result& result ){
+    if( !result.has_next ){
+        cout << "no more pieces " << endl;
+    }
+    if( !result.can_glue ){
+        cout << "cannot find a feasible solution. remaining pieces : " << t.noRemainingPieces() << endl;
+    }
+    if( !result.enough_free_poles ){
+        cout << "there aren't enough free poles. remaining pieces :" << t.noRemainingPieces() << endl;
+    }
+    t.print();
+
+}
+
+}}
@@ -0,0 +1,37 @@
+//
+//  toolbox_step.h
+//  MeshEditE
+//
+//  Moved out of ConsoleFuncs/engine_console_funcs.cpp so that pam_generate can share it.
+//
+//  Created by Francesco Usai on 08/04/15.
+//  Copyright (c) 2015 J. Andreas Bærentzen. All rights reserved.
+//
+
+#ifndef __MeshEditE__toolbox_step__
+#define __MeshEditE__toolbox_step__
+
+#include <stdio.h>
+
+#include <MeshEditE/Procedural/StatefulEngine.h>
+#include <MeshEditE/Procedural/Toolbox.h>
+
+namespace Procedural{
+    namespace Helpers{
+
+struct toolbox_step_result{
+    bool has_next           = true;
+    bool can_glue           = true;
+    bool enough_free_poles  = true;
+    inline bool ok() { return has_next && can_glue && enough_free_poles ; }
+};
+
+/// picks the next module from the toolbox and glues it to the engine's host.
+/// the module is given back to the toolbox if it cannot be glued
+toolbox_step_result toolbox_step( Procedural::Toolbox &t, Procedural::Engines::StatefulEngine &s );
+
+void toolbox_handle_result( const Procedural::Toolbox &t, const toolbox_step_result& result );
+
+}}
+
+#endif /* defined(__MeshEditE__toolbox_step__) */
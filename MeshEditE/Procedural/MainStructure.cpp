@@ -12,6 +12,9 @@
 #include <set>
 #include <algorithm>
 
+#include <MeshEditE/HMeshParallelKit.h>
+#include "Operations/structural_operations.h"
+
 #include "Test.h"
 
 using namespace std;
@@ -21,64 +24,68 @@ using namespace Procedural;
 namespace Procedural{
     
     MainStructure::MainStructure(){
-        time = 0;
-        skel = new Skeleton();
+        time        = 0;
+        noPoleIDs   = 0;
+        skel        = new Skeleton();
+    }
+    
+    MainStructure::~MainStructure(){
+        delete skel->cd_hierarchy;
+        delete skel;
     }
 
     const PoleList& MainStructure::getPoles() const {
-        return freePoles;
+        return freePoleTable.getIDs();
     }
 
     const PoleList& MainStructure::getFreePoles() const{
-        return freePoles;
-    }
-    
-    const PoleSet& MainStructure::getFreePoleSet() const{
-        return freePolesSet;
+        return freePoleTable.getIDs();
     }
 
     const PoleList& MainStructure::getGluedPoles() const{
-        return freePoles;
+        return freePoleTable.getIDs();
     }
     
     const PoleInfo& MainStructure::getPoleInfo( HMesh::VertexID p ) const{
-        assert(freePoleInfoMap.count(p) > 0);
-        return freePoleInfoMap.at( p );
+        assert( freePoleTable.count( p ) > 0 );
+        return freePoleTable.at( p );
     }
 
     bool _in_set( set<VertexID > &s, VertexID v ){
         return ( s.count(v) > 0 );
     }
     
-    void MainStructure::reAlignIDs( HMesh::VertexIDRemap &remapper ){
-        
-        PoleInfoMap p;
-        freePolesSet.clear();
+    void MainStructure::glueModule( Module &m, vector<Match> &matches ){
+        GluedModuleInfo gmi;
+        VertexIDTable   table;
         
-        for( int i = 0; i < freePoles.size(); ++i ){
-            VertexID newID = remapper[freePoles[i]];
-            p[newID] = freePoleInfoMap[freePoles[i]];
-            freePoles[i] = newID;
-            freePolesSet.insert( newID );
+        // the poles of the module get new structure IDs, the module and the matches are realigned to them
+        for( VertexID v : m.poleList ){
+            VertexID id = VertexID( noPoleIDs++ );
+            if( v.get_index() >= table.size( )){ table.resize( v.get_index() + 1, InvalidVertexID ); }
+            table[v.get_index()] = id;
+            gmi.poles.push_back( make_pair( v, id ));
         }
-        for( int i = 0; i < gluedPoles.size(); ++i ){
-            gluedPoles[i] = remapper[gluedPoles[i]];
+        for( Match& match : matches ){
+            match.first = remapped( table, match.first );
         }
-        freePoleInfoMap = std::move( p );
-        skel->reAlignIDs( remapper );
-    }
-    
-    void MainStructure::glueModule( Module &m, vector<Match> &matches ){
+        m.reAlignIDs( table );
+        
         set<VertexID> glued_m_poles;
         set<VertexID> glued_h_poles;
         
+        // the cells are sized on the first module ( the host ), about the spacing of its poles
+        if( modules.empty() && m.bsphere_radius > 0.0 ){
+            freePoleGrid.setCellSize( m.bsphere_radius / 2.0 );
+        }
+        
         // for assert purposes
-        size_t  old_free_poles_size = freePoles.size(),
+        size_t  old_free_poles_size = freePoleTable.size(),
                 old_glued_poles_size = gluedPoles.size();
         
         for( Match match : matches){
             assert( find( m.poleList.begin(), m.poleList.end(), match.first ) != m.poleList.end( ));
-            assert( find( freePoles.begin(), freePoles.end(), match.second ) != freePoles.end( ));
+            assert( isFreePole( match.second ));
             glued_m_poles.insert( match.first );
             glued_h_poles.insert( match.second );
         }
@@ -88,38 +95,36 @@ namespace Procedural{
                 gluedPoles.push_back( v );
             }
             else{
-                freePoles.push_back( v );
-                freePolesSet.insert( v );
-                freePoleInfoMap[v] = m.getPoleInfo( v );
+                freePoleTable.set( v, m.getPoleInfo( v ));
+                freePoleGrid.insert( v, m.getPoleInfo( v ).geometry.pos );
             }
         }
-        // remove from freePoles the host poles involved  and put them into gluedPoles
+        // remove from the free poles the host poles involved and put them into gluedPoles
         for( VertexID v : glued_h_poles ){
-            freePoles.erase( remove(freePoles.begin(), freePoles.end(), v));
-            freePolesSet.erase( v );
             gluedPoles.push_back( v );
-            assert( freePoleInfoMap.count(v) > 0 );
-            freePoleInfoMap.erase( v );
+            assert( isFreePole( v ));
+            freePoleGrid.erase( v, freePoleTable.at( v ).geometry.pos );
+            freePoleTable.erase( v );
         }
         assert( glued_h_poles.size() == glued_m_poles.size() );
-        assert( freePoles.size() == freePolesSet.size());
         assert( old_glued_poles_size + glued_m_poles.size() + glued_h_poles.size() == gluedPoles.size() );
         assert( old_free_poles_size + ( m.poleList.size() - glued_m_poles.size( ) - glued_h_poles.size())
-                == freePoles.size());
+                == freePoleTable.size());
         assert( old_glued_poles_size + old_free_poles_size + m.poleList.size()
-                == freePoles.size() + gluedPoles.size());
+                == freePoleTable.size() + gluedPoles.size());
         
-        GluedModuleInfo gmi;
         gmi.module              = &m;
         gmi.t_start             = time;
         gmi.connection_valence  = matches.size();
+        gmi.transform           = m.placement;
+        gmi.glued               = matches;
 
         modules.push_back( gmi );
         ++time;
         
         /***** DEBUG AND SANITY CHECK ****/
         cout << glued_m_poles.size() << "-valent glueing at time : " << time << endl;
-        cout << " num of free poles " << freePoles.size() << " # set : " << freePolesSet.size();
+        cout << " num of free poles " << freePoleTable.size();
         cout << " num of glued poles " << gluedPoles.size() << endl;
         /*****          END         ****/
         
@@ -129,10 +134,99 @@ namespace Procedural{
 
     }
     
+    void MainStructure::glueModules( vector<Placement> &placements ){
+        set<VertexID> used;
+        for( const Placement& p : placements ){
+            for( const Match& match : p.matches ){
+                assert( isFreePole( match.second ));
+                bool is_new = used.insert( match.second ).second;
+                assert( is_new );
+            }
+        }
+        for( Placement& p : placements ){
+            glueModule( *p.module, p.matches );
+        }
+    }
+    
+    void MainStructure::bake( Manifold &out ) const{
+        size_t no_modules = modules.size();
+        vector< size_t > vertex_start( no_modules + 1, 0 ),
+                         face_start( no_modules + 1, 0 ),
+                         index_start( no_modules + 1, 0 );
+        
+        // each module owns a contiguous range of the arrays given to Manifold::build
+        parallel_for( size_t( 0 ), no_modules, [&]( size_t i ){
+            const Manifold& mm = *modules[i].module->m;
+            size_t no_indices = 0;
+            for( FaceID f : mm.faces( )){ no_indices += no_edges( mm, f ); }
+            vertex_start[i+1]   = mm.no_vertices();
+            face_start[i+1]     = mm.no_faces();
+            index_start[i+1]    = no_indices;
+        }, 1 );
+        for( size_t i = 0; i < no_modules; ++i ){
+            vertex_start[i+1]   += vertex_start[i];
+            face_start[i+1]     += face_start[i];
+            index_start[i+1]    += index_start[i];
+        }
+        
+        vector< CGLA::Vec3d > positions( vertex_start.back( ));
+        vector< int >         faces( face_start.back( ));
+        vector< int >         indices( index_start.back( ));
+        vector< int >         pole_vertex( noPoleIDs, -1 );
+        
+        parallel_for( size_t( 0 ), no_modules, [&]( size_t i ){
+            const GluedModuleInfo&      gmi = modules[i];
+            const Manifold&             mm  = *gmi.module->m;
+            VertexAttributeVector<int>  local( mm.allocated_vertices(), -1 );
+            
+            size_t v_i = vertex_start[i], f_i = face_start[i], i_i = index_start[i];
+            for( VertexID v : mm.vertices( )){
+                local[v]            = static_cast<int>( v_i );
+                positions[v_i++]    = gmi.transform.mul_3D_point( mm.pos( v ));
+            }
+            for( FaceID f : mm.faces( )){
+                int n = 0;
+                for( Walker w = mm.walker( f ); !w.full_circle(); w = w.next( ), ++n ){
+                    indices[i_i++] = local[w.vertex()];
+                }
+                faces[f_i++] = n;
+            }
+            for( const Match& p : gmi.poles ){
+                pole_vertex[p.second.get_index()] = local[p.first];
+            }
+        }, 1 );
+        
+        out.clear();
+        out.build( positions.size(), reinterpret_cast< const double* >( positions.data( )),
+                   faces.size(), faces.data(), indices.data( ));
+        
+        vector< VertexID > ids;
+        ids.reserve( positions.size( ));
+        for( VertexID v : out.vertices( )){ ids.push_back( v ); }
+        
+        // glued in the same order they were glued in the structure
+        for( const GluedModuleInfo& gmi : modules ){
+            for( const Match& match : gmi.glued ){
+                assert( pole_vertex[match.first.get_index()] >= 0 && pole_vertex[match.second.get_index()] >= 0 );
+                VertexID p1 = ids[pole_vertex[match.first.get_index()]],
+                         p2 = ids[pole_vertex[match.second.get_index()]];
+                if( !Operations::Structural::glue_poles( out, p1, p2 )){
+                    cout << "unable to glue poles " << match.first << " and " << match.second << endl;
+                }
+            }
+        }
+        out.cleanup();
+    }
+    
     bool MainStructure::isColliding(const Module &m) const{
         return Procedural::collide( *( this->skel ), m.getSkeleton() );
     }
     
+    void MainStructure::collidingPoses( const Module& m, const std::vector< CGLA::Mat4x4d >& poses,
+                                        std::vector< bool >& colliding, double tolerance ) const{
+        Procedural::collide( *( this->skel ), m.getSkeleton(), poses, colliding, tolerance );
+    }
+    
     void MainStructure::saveBVH( std::string path ) const{
         skel->saveCollisionDetectionHierarchyToFile( path );
     }
@@ -10,6 +10,7 @@
 #define __MeshEditE__MainStructure__
 
 #include "Module.h"
+#include "PoleGrid.h"
 
 #include <stdio.h>
 #include <set>
@@ -27,41 +28,68 @@ struct StructurePoleInfo{
     ModuleID    moduleID;      // id of the module inside the structure
 };
     
+/// a module instance inside the structure. the geometry is not copied into the structure,
+/// module->m is the untransformed toolbox mesh and transform places it, see MainStructure::bake
 struct GluedModuleInfo{
-    Module          *module;
-    size_t          t_start;
-    size_t          connection_valence;
+    Module              *module;
+    size_t              t_start;
+    size_t              connection_valence;
+    CGLA::Mat4x4d       transform;
+    std::vector<Match>  poles;      // ( vertex of module->m, structure pole )
+    std::vector<Match>  glued;      // ( structure pole of this module, structure pole of the host )
+};
+
+/// a module ready to be glued, matches are ( pole of module, free pole of the structure )
+struct Placement{
+    Module              *module;
+    std::vector<Match>  matches;
 };
 
 class MainStructure{
     
 public:
     MainStructure();
-    // those methods work only on a logical basis not on a geometrical one
+    // frees the skeleton only, the glued modules belong to whoever glued them
+    ~MainStructure();
+    MainStructure( MainStructure const& )       = delete;
+    void operator = ( MainStructure const& )    = delete;
+    // those methods work only on a logical basis not on a geometrical one.
+    // matches are ( pole of m, free pole of the structure ), m is owned by the structure
+    // afterwards and its poles take the structure pole IDs, that never change
     void glueModule( Module &m, std::vector<Match> &matches  );
-    void reAlignIDs( HMesh::VertexIDRemap &remapper );
+    // glues the placements in order. they must not share any free pole of the structure
+    void glueModules( std::vector<Placement> &placements );
+    // rebuilds out from the module instances and glues their poles. the instances are
+    // transformed in parallel and the half-edge mesh is built once
+    void bake( HMesh::Manifold &out ) const;
     bool isColliding( const Module& m ) const;
+    // colliding[i] is true if m, moved by poses[i], intersects the structure
+    void collidingPoses( const Module& m, const std::vector< CGLA::Mat4x4d >& poses,
+                         std::vector< bool >& colliding, double tolerance = 0.0 ) const;
     void saveSkeleton( std::string path ) const;
     void saveBVH( std::string path ) const;
     
     const Procedural::PoleList& getPoles() const;
     const Procedural::PoleList& getFreePoles() const;
     const Procedural::PoleList& getGluedPoles() const;
-    const Procedural::PoleSet&  getFreePoleSet() const;
+    inline bool                 isFreePole( HMesh::VertexID p ) const { return ( freePoleTable.count( p ) > 0 ); }
     const PoleInfo&             getPoleInfo( HMesh::VertexID p ) const;
-    inline const PoleInfoMap&   getPoleInfoMap() const{ return freePoleInfoMap;}
+    inline const PoleTable&     getPoleTable() const{ return freePoleTable;}
+    // spatial index of the free poles, kept up to date by glueModule
+    inline const PoleGrid&      getPoleGrid() const{ return freePoleGrid; }
+    inline size_t               noModules() const { return modules.size(); }
     
 private:
 /************************************************
  * ATTRIBUTES                                   *
  ***********************************************/
     std::vector< GluedModuleInfo >  modules;
-    Procedural::PoleList            freePoles;
     Procedural::PoleList            gluedPoles;
-    PoleSet                         freePolesSet;
     size_t                          time;
-    PoleInfoMap                     freePoleInfoMap;
+    PoleTable                       freePoleTable;  // its IDs are the free poles
+    PoleGrid                        freePoleGrid;
     Skeleton                        *skel;
+    size_t                          noPoleIDs;      // structure poles are numbered 0, 1, ...
 
 };
 
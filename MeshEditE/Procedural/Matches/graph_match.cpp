@@ -8,6 +8,8 @@
 
 #include "graph_match.h"
 #include <MeshEditE/Procedural/Helpers/geometric_properties.h>
+#include <algorithm>
+#include <limits>
 
 //#include "geometric_properties.h"
 using namespace std;
@@ -17,17 +19,119 @@ namespace Procedural{
     namespace GraphMatch{
 
 
-void graphStruct_difference( GraphStruct &g1, GraphStruct &g2, GraphStruct &g )
+GraphStruct::GraphStruct( size_t no_nodes )
+{
+    no_slots            = no_nodes;
+    alive_count         = no_nodes;
+    double max_value    = std::numeric_limits<double>::max();
+    size_t no_arcs      = no_nodes * ( no_nodes - 1 ) / 2;
+    // add nodes
+    alive.assign(( no_nodes + 63 ) / 64, 0 );
+    for( size_t i = 0; i < no_nodes; ++i ) { alive[i >> 6] |= uint64_t( 1 ) << ( i & 63 ); }
+    // add arcs
+    dist.assign(    no_arcs, max_value );
+    cosine.assign(  no_arcs, max_value );
+    star_dist.assign(   no_nodes, 0.0 );
+    star_cosine.assign( no_nodes, 0.0 );
+    stars_valid = false;
+}
+
+// the arcs of removed nodes are zero, so each row is summed without looking at the mask.
+// every row adds its whole sum to its own node and one element to each of the following nodes,
+// both loops run over contiguous memory and are vectorized by the compiler
+void GraphStruct::buildStars() const
+{
+    std::fill( star_dist.begin(),   star_dist.end(),   0.0 );
+    std::fill( star_cosine.begin(), star_cosine.end(), 0.0 );
+    for( size_t i = 0; i + 1 < no_slots; ++i )
+    {
+        const double*   d   = dist.data()   + rowStart( i );
+        const double*   c   = cosine.data() + rowStart( i );
+        double*         sd  = star_dist.data()   + i + 1;
+        double*         sc  = star_cosine.data() + i + 1;
+        size_t          len = no_slots - i - 1;
+        // four independent partial sums, so that the reduction is not bound to a single accumulator
+        double acc_d[4] = { 0.0, 0.0, 0.0, 0.0 },
+               acc_c[4] = { 0.0, 0.0, 0.0, 0.0 };
+        size_t k = 0;
+        for( ; k + 4 <= len; k += 4 )
+        {
+            for( size_t l = 0; l < 4; ++l )
+            {
+                acc_d[l] += d[k + l];
+                acc_c[l] += c[k + l];
+            }
+        }
+        for( ; k < len; ++k )
+        {
+            acc_d[0] += d[k];
+            acc_c[0] += c[k];
+        }
+        for( k = 0; k < len; ++k )
+        {
+            sd[k] += d[k];
+            sc[k] += c[k];
+        }
+        star_dist[i]   += ( acc_d[0] + acc_d[1] ) + ( acc_d[2] + acc_d[3] );
+        star_cosine[i] += ( acc_c[0] + acc_c[1] ) + ( acc_c[2] + acc_c[3] );
+    }
+    stars_valid = true;
+}
+
+void GraphStruct::RemoveNode( GraphNode node )
+{
+    assert( exists( node ));
+    alive[node >> 6] &= ~( uint64_t( 1 ) << ( node & 63 ));
+    --alive_count;
+    assert( !exists( node ));
+
+    // column of the node, one element per row above it
+    for( size_t i = 0; i < node; ++i )
+    {
+        size_t k = rowStart( i ) + node - i - 1;
+        if( stars_valid )
+        {
+            star_dist[i]   -= dist[k];
+            star_cosine[i] -= cosine[k];
+        }
+        dist[k]   = 0.0;
+        cosine[k] = 0.0;
+    }
+    // row of the node
+    double* d   = dist.data()   + rowStart( node );
+    double* c   = cosine.data() + rowStart( node );
+    size_t  len = no_slots - node - 1;
+    if( stars_valid )
+    {
+        double* sd = star_dist.data()   + node + 1;
+        double* sc = star_cosine.data() + node + 1;
+        for( size_t k = 0; k < len; ++k )
+        {
+            sd[k] -= d[k];
+            sc[k] -= c[k];
+        }
+    }
+    std::fill( d, d + len, 0.0 );
+    std::fill( c, c + len, 0.0 );
+    star_dist[node]   = 0.0;
+    star_cosine[node] = 0.0;
+}
+
+
+void graphStruct_difference( const GraphStruct &g1, const GraphStruct &g2, GraphStruct &g )
 {
     // they should have the same node set and arc set
     // will check only the number of nodes ( assumptions can be made accordingly to the constructor )
-    assert( g1.nodes.size() == g1.nodes.size() );
-    size_t no_nodes = g1.nodes.size();
+    assert( g1.size() == g2.size() );
+    size_t no_nodes = g1.size();
     g = GraphStruct( no_nodes );
     
-    for( GraphEdge e : g.arcs )
+    for( GraphNode i = 0; i < no_nodes; ++i )
     {
-        g.setCost( e, g1.getCost( e ) - g2.getCost( e ));
+        for( GraphNode j = i + 1; j < no_nodes; ++j )
+        {
+            g.setCost( i, j, g1.getCost( i, j ) - g2.getCost( i, j ));
+        }
     }
 }
 
@@ -40,22 +144,21 @@ GraphEdge build_edge( GraphNode n1, GraphNode n2 )
 }
         
 
-void fill_graph( const PoleList &poles, const PoleInfoMap& poleInfo, GraphStruct &g, ManifoldToGraph &mtg ){
+// positions and normals are indexed by graph node
+void fill_graph( const vector< CGLA::Vec3d > &pos, const vector< CGLA::Vec3d > &normals, GraphStruct &g ){
     // calculate costs save them into the graph
-    for( GraphEdge e : g.arcs )
+    for( GraphNode i = 0; i < g.size(); ++i )
+    for( GraphNode j = i + 1; j < g.size(); ++j )
     {
-        VertexID v1 = mtg.getVertexId( e.first ),
-                 v2 = mtg.getVertexId( e.second );
+        GraphEdge e = build_edge( i, j );
+        assert( e.first < pos.size() && e.second < pos.size( ));
         
-        assert( poleInfo.count( v1 ) > 0 );
-        assert( poleInfo.count( v2 ) > 0 );
-        
-        CGLA::Vec3d n1 = poleInfo.at( v1 ).geometry.normal,
-                    n2 = poleInfo.at( v2 ).geometry.normal;
+        CGLA::Vec3d n1 = normals[e.first],
+                    n2 = normals[e.second];
         n1.normalize();
         n2.normalize();
 #warning consider using squared length
-        double distance = ( poleInfo.at( v1 ).geometry.pos - poleInfo.at( v2 ).geometry.pos ).length();
+        double distance = ( pos[e.first] - pos[e.second] ).length();
         double cos      = dot( n1, n2 ) + 1.0;
         // since cos is in the range [-1, 1] and I use differences, I apply an offset to the range [ 0, 2 ]
         
@@ -66,26 +169,28 @@ void fill_graph( const PoleList &poles, const PoleInfoMap& poleInfo, GraphStruct
 }
         
         
-void normalize_costs( GraphStruct &g1, GraphStruct g2, double max_distance ){
+void normalize_costs( GraphStruct &g1, GraphStruct &g2, double max_distance ){
     // normalize edge cost values
-    for( GraphEdge e : g1.arcs )
+    for( GraphStruct* g : { &g1, &g2 } )
     {
-        g1.setCost( e, std::make_pair( g1.getCost( e ).first / max_distance, g1.getCost( e ).second / 2.0 ));
-#warning here I need a well thoughed assert
-    }
-    for( GraphEdge e : g2.arcs )
-    {
-        g2.setCost( e, std::make_pair( g2.getCost( e ).first / max_distance, g2.getCost( e ).second / 2.0 ));
+        for( GraphNode i = 0; i < g->size(); ++i )
+        for( GraphNode j = i + 1; j < g->size(); ++j )
+        {
+            if( !g->exists( i ) || !g->exists( j )) { continue; }
+            EdgeCost c = g->getCost( i, j );
+            g->setCost( i, j, std::make_pair( c.first / max_distance, c.second / 2.0 ));
 #warning here I need a well thoughed assert
+        }
     }
 }
 
-void get_subsets( const MainStructure& main, const Module& module,
-                  const std::vector< Match >& proposed,
-                  std::vector< SubsetResult >& result, EdgeCost treshold ){
+// module and main geometry are gathered in the same order of proposed
+static void get_subsets_from_geometry( const std::vector< Match >& proposed,
+                                       const vector< CGLA::Vec3d > &module_pos, const vector< CGLA::Vec3d > &module_normals,
+                                       const vector< CGLA::Vec3d > &main_pos,   const vector< CGLA::Vec3d > &main_normals,
+                                       std::vector< SubsetResult >& result, EdgeCost treshold ){
     
     size_t no_nodes = proposed.size();
-    EdgeCost cost_sum = make_pair( 0.0, 0.0 );
     
     PoleList main_poles, module_poles;
     
@@ -102,9 +207,9 @@ void get_subsets( const MainStructure& main, const Module& module,
     ManifoldToGraph mtg_main( main_poles );
 
     // fill graph costs for module
-    fill_graph( module_poles, module.getPoleInfoMap(), gm, mtg_module );
+    fill_graph( module_pos, module_normals, gm );
     // fill graph costs for main
-    fill_graph( main_poles, main.getPoleInfoMap(), gh, mtg_main );
+    fill_graph( main_pos, main_normals, gh );
     // build difference graph
     graphStruct_difference( gm, gh, g );
     
@@ -117,39 +222,8 @@ void get_subsets( const MainStructure& main, const Module& module,
     for( size_t i = 0; i < no_nodes - 1 && go_on; ++i )
     {
         result.push_back( s0 );
-        
-        map< GraphNode, EdgeCost > total_cost;
-        // per ogni vertice
-        for( size_t idx : g.nodes )
-        {
-            if( g.exists( idx ))
-            {
-                vector< GraphEdge > star;
-                // prendere la sua star
-                g.getStar( idx, star );
-                total_cost[idx] = make_pair( 0.0, 0.0 );
-                // calcolare la somma dei costi della star
-                for( GraphEdge e : star )
-                {
-                    total_cost[idx] = total_cost[idx] + g.getCost( e );
-                }
-            }
-        }
-        
-        EdgeCost    max_cost = ( *total_cost.begin( )).second;
-        GraphNode   choosen  = ( *total_cost.begin( )).first;
-        
-        // scegliere il vertice con il costo maggiore della star
-        for( const auto& star_cost : total_cost )
-        {
-            if( star_cost.second > max_cost )
-            {
-                max_cost = star_cost.second;
-                choosen  = star_cost.first;
-            }
-        }
-        // rimuoverlo dal grafo
-        g.RemoveNode( choosen );
+        // the star costs are updated incrementally by the removal
+        remove_most_expensive_node( g );
         getSubsetResult( g, mtg_main, mtg_module, s0 );
         go_on = s0.cost < treshold;
     }
@@ -160,14 +234,56 @@ void get_subsets( const MainStructure& main, const Module& module,
 }
     
         
+void get_subsets( const MainStructure& main, const Module& module,
+                  const std::vector< Match >& proposed,
+                  std::vector< SubsetResult >& result, EdgeCost treshold ){
+    
+    vector< CGLA::Vec3d > module_pos, module_normals, main_pos, main_normals;
+    
+    const PoleTable& module_poles = module.getPoleTable();
+    const PoleTable& main_poles   = main.getPoleTable();
+    for( const auto& pole_and_vertex : proposed )
+    {
+        PoleTable::Slot module_slot = module_poles.slot( pole_and_vertex.first ),
+                        main_slot   = main_poles.slot( pole_and_vertex.second );
+        module_pos.push_back( module_poles.pos( module_slot ));
+        module_normals.push_back( module_poles.normal( module_slot ));
+        main_pos.push_back( main_poles.pos( main_slot ));
+        main_normals.push_back( main_poles.normal( main_slot ));
+    }
+    get_subsets_from_geometry( proposed, module_pos, module_normals, main_pos, main_normals, result, treshold );
+}
+        
+        
+void get_subsets( const MainStructure& main, const TransformedModuleView& module,
+                  const std::vector< Match >& proposed,
+                  std::vector< SubsetResult >& result, EdgeCost treshold ){
+    
+    vector< CGLA::Vec3d > module_pos, module_normals, main_pos, main_normals;
+    
+    const PoleTable& module_poles = module.getPoleTable();
+    const PoleTable& main_poles   = main.getPoleTable();
+    for( const auto& pole_and_vertex : proposed )
+    {
+        PoleTable::Slot module_slot = module_poles.slot( pole_and_vertex.first ),
+                        main_slot   = main_poles.slot( pole_and_vertex.second );
+        module_pos.push_back( module.slotPos( module_slot ));
+        module_normals.push_back( module.slotNormal( module_slot ));
+        main_pos.push_back( main_poles.pos( main_slot ));
+        main_normals.push_back( main_poles.normal( main_slot ));
+    }
+    get_subsets_from_geometry( proposed, module_pos, module_normals, main_pos, main_normals, result, treshold );
+}
+    
+        
 void getSubsetResult( const GraphStruct& g, const ManifoldToGraph& mtg_main, const ManifoldToGraph& mtg_module,
                       SubsetResult& result ){
     result.cost = make_pair( 0.0, 0.0 );
     result.matches.clear();
-    for( GraphNode index : g.nodes )
+    for( GraphNode index = 0; index < g.size(); ++index )
     {
         if( g.exists( index )) {
-            result.cost = result.cost + getStarTotalCost( g, index );
+            result.cost = result.cost + g.getStarCost( index );
             result.matches.push_back( make_pair( mtg_module.getVertexId( index ), mtg_main.getVertexId( index )));
         }
     }
@@ -176,10 +292,10 @@ void getSubsetResult( const GraphStruct& g, const ManifoldToGraph& mtg_main, con
 EdgeCost getGraphTotalCost( const GraphStruct& g ){
     EdgeCost cost_sum = make_pair( 0.0, 0.0 );
     // save the matches
-    for( GraphNode index : g.nodes )
+    for( GraphNode index = 0; index < g.size(); ++index )
     {
         if( g.exists( index )) {
-            cost_sum = cost_sum + getStarTotalCost( g, index );
+            cost_sum = cost_sum + g.getStarCost( index );
         }
     }
     return cost_sum;
@@ -187,41 +303,26 @@ EdgeCost getGraphTotalCost( const GraphStruct& g ){
         
 EdgeCost getStarTotalCost( const GraphStruct &g, GraphNode n )
 {
-    vector< GraphEdge > star;
-    EdgeCost cost = make_pair( 0.0, 0.0 );
-    // prendere la sua star
-    g.getStar( n, star );
-    // calcolare la somma dei costi della star
-    for( GraphEdge e : star )
-    {
-        cost = cost + g.getCost( e );
-    }
-    return cost;
+    return g.getStarCost( n );
 }
         
         
 GraphNode remove_most_expensive_node( GraphStruct &g )
 {
-    map< GraphNode, EdgeCost > total_cost;
-    // per ogni vertice
-    for( size_t idx : g.nodes )
-    {
-        if( g.exists( idx ))
-        {
-            total_cost[idx] = getStarTotalCost( g, idx );
-        }
-    }
-    
-    EdgeCost    max_cost = (*total_cost.begin()).second;
-    GraphNode   choosen  = (*total_cost.begin()).first;
+    assert( g.no_nodes() > 0 );
+    GraphNode   choosen  = 0;
+    while( !g.exists( choosen )) { ++choosen; }
+    EdgeCost    max_cost = g.getStarCost( choosen );
     
     // scegliere il vertice con il costo maggiore della star
-    for( const auto& star_cost : total_cost )
+    for( GraphNode idx = choosen + 1; idx < g.size(); ++idx )
     {
-        if( star_cost.second > max_cost )
+        if( !g.exists( idx )) { continue; }
+        EdgeCost star_cost = g.getStarCost( idx );
+        if( star_cost > max_cost )
         {
-            max_cost = star_cost.second;
-            choosen  = star_cost.first;
+            max_cost = star_cost;
+            choosen  = idx;
         }
     }
     // rimuoverlo dal grafo
@@ -255,9 +356,9 @@ std::ostream& graph_print (std::ostream &out, GraphEdge &edge)
         
 std::ostream& operator<< (std::ostream &out, GraphStruct &g)
 {
-        out << " the graph has : " << g.no_nodes() << " nodes and " << g.arcs.size() << " edges " << std::endl;
+        out << " the graph has : " << g.no_nodes() << " nodes and " << g.no_nodes() * ( g.no_nodes() - 1 ) / 2 << " edges " << std::endl;
         out << "the nodes are :" << std::endl;
-        for( GraphNode n : g.nodes )
+        for( GraphNode n = 0; n < g.size(); ++n )
         {
             if(g.exists(n))
             {
@@ -265,8 +366,11 @@ std::ostream& operator<< (std::ostream &out, GraphStruct &g)
             }
         }
         out << "the arcs are :" << std::endl;
-        for( const auto& e : g.arcs )
+        for( GraphNode i = 0; i < g.size(); ++i )
+        for( GraphNode j = i + 1; j < g.size(); ++j )
         {
+            if( !g.exists( i ) || !g.exists( j )) { continue; }
+            GraphEdge e = build_edge( i, j );
             graph_print(out, e) ;
             out << " ==> ";
             graph_print(out, g.getCost(e))  << std::endl ;
@@ -10,12 +10,14 @@
 #define __MeshEditE__graph_match__
 
 #include <stdio.h>
-#include <stack>
+#include <vector>
+#include <cstdint>
 #include <ostream>
 #include <GEL/HMesh/Manifold.h>
 
 #include <MeshEditE/Procedural/Module.h>
 #include <MeshEditE/Procedural/MainStructure.h>
+#include <MeshEditE/Procedural/TransformedModuleView.h>
 
 
 #define EDGE_COST_EPS 0.00000001
@@ -102,126 +104,84 @@ public:
 };
 
 /// super simple graph structure, manages only complete graphs
-/// nodes are numbered from 0 to no_nodes - 1
+/// nodes are numbered from 0 to size() - 1
 /// initialization is super-simple as well, just feed the number of nodes
 /// it will create the complete graph, then set the various costs.
 /// if a cost is not set it will be the maximum
-/// nodes cannot be added to this structure
-/// nodes can be deleted from this structure, simply they will be set as -1 at the corresponding index
+/// nodes cannot be added to this structure, they can only be deleted
+/// the costs are kept in a dense upper triangular matrix ( distances and cosines in two separate
+/// arrays ) and the alive nodes in a bitmask. The star cost of every node is computed once after the
+/// costs have been set and then kept up to date by RemoveNode, so pruning the graph costs O( n ) per
+/// removed node instead of O( n^2 )
 struct GraphStruct
 {
 private :
-    std::map< GraphEdge, EdgeCost > costs;
-    size_t                          max_node_idx;
-    
+    size_t                      no_slots    = 0;
+    size_t                      alive_count = 0;
+    std::vector< uint64_t >     alive;      // one bit per node
+    std::vector< double >       dist;       // upper triangle, row by row
+    std::vector< double >       cosine;
+    // star costs, rebuilt lazily after setCost
+    mutable std::vector< double > star_dist;
+    mutable std::vector< double > star_cosine;
+    mutable bool                  stars_valid = false;
+
+    // first element of the row of i ( the edges ( i, j ) with j > i )
+    inline size_t rowStart( size_t i ) const { return i * ( 2 * no_slots - i - 1 ) / 2; }
+    inline size_t index( GraphNode i, GraphNode j ) const
+    {
+        if( i > j ) { std::swap( i, j ); }
+        assert( i != j && j < no_slots );
+        return rowStart( i ) + j - i - 1;
+    }
+    void buildStars() const;
+
 public :
-    std::vector<GraphNode> nodes;
-    std::vector<GraphEdge> arcs;
-    
-    inline bool exists( GraphNode n )const { return ( n <= max_node_idx && nodes[n] == n ); }
+    inline bool exists( GraphNode n )const { return ( n < no_slots && ( alive[n >> 6] >> ( n & 63 )) & 1 ); }
     inline bool exists( GraphEdge e )const { return ( exists( e.first ) && exists( e.second )); }
     
-    inline size_t no_nodes()
-    {
-        size_t count = 0;
-        for ( auto n : nodes ) { if( exists(n)) ++count; }
-        return count;
-    }
+    // number of node slots, removed nodes included
+    inline size_t size()     const { return no_slots; }
+    inline size_t no_nodes() const { return alive_count; }
     
-    inline void setCost( GraphEdge e, EdgeCost cost )
-    {
-        assert( exists( e ));
-        costs[e] = cost;
-    }
+    inline void setCost( GraphEdge e, EdgeCost cost ) { setCost( e.first, e.second, cost ); }
     
     inline void setCost( GraphNode n1, GraphNode n2, EdgeCost cost )
     {
         assert( exists( n1 ));
         assert( exists( n2 ));
-        costs[build_edge( n1, n2 )] = cost;
+        size_t k    = index( n1, n2 );
+        dist[k]     = cost.first;
+        cosine[k]   = cost.second;
+        stars_valid = false;
     }
     
-    inline EdgeCost getCost( GraphEdge e )const
-    {
-        assert( exists( e ));
-        return costs.at( e );
-    }
+    inline EdgeCost getCost( GraphEdge e )const { return getCost( e.first, e.second ); }
     
     inline EdgeCost getCost( GraphNode n1, GraphNode n2 ) const
     {
         assert( exists( n1 ));
         assert( exists( n2 ));
-        return costs.at( build_edge( n1, n2 ));
+        size_t k = index( n1, n2 );
+        return std::make_pair( dist[k], cosine[k] );
     }
     
-    inline void getStar( GraphNode n, std::vector< GraphEdge > &star ) const
+    /// sum of the costs of the arcs between n and the other alive nodes
+    inline EdgeCost getStarCost( GraphNode n ) const
     {
         assert( exists( n ));
-        for( size_t i = 0; i < max_node_idx; ++i )
-        {
-            if( exists( i ))
-            {
-                if( i < n ) { star.push_back( std::make_pair( i, n )); }
-                if( i > n ) { star.push_back( std::make_pair( n, i )); }
-            }
-        }
+        if( !stars_valid ) { buildStars(); }
+        return std::make_pair( star_dist[n], star_cosine[n] );
     }
     
     GraphStruct(){}
-    
-    GraphStruct( size_t no_nodes )
-    {
-        assert( no_nodes >= 0 );
-        max_node_idx        = no_nodes - 1;
-        double max_value    = std::numeric_limits<double>::max();
-        EdgeCost c          = std::make_pair( max_value, max_value );
-        // add nodes
-        for( size_t i = 0; i < no_nodes; ++i )
-        {
-            nodes.push_back( (int)i );
-        }
-        // add arcs
-        for( size_t i = 0; i <= no_nodes; ++i )
-        {
-            for( size_t j = i+1; j < no_nodes; ++j )
-            {
-                GraphEdge e = build_edge( (int)i, (int)j );
-                arcs.push_back( e );
-                costs[e] = c;
-            }
-        }
-    }
+    GraphStruct( size_t no_nodes );
     
     /// removing a node of the graph involves :
-    /// putting -1 in its corresponding position in the node's vector
-    /// removing all of its arcs
-    /// putting max_value as cost for each of its arcs
-    void RemoveNode( size_t node )
-    {
-        double max_value    = std::numeric_limits<double>::max();
-        EdgeCost c          = std::make_pair( max_value, max_value );
-
-        nodes[node] = -1;
-        assert( !exists( node ));
-
-        // save all the arcs where
-        typedef std::vector<GraphEdge>::iterator    arc_iter;
-        std::stack<arc_iter>                        to_delete;
-        // mark every arc outgoing from the node to be deleted
-        for( arc_iter it = arcs.begin(); it != arcs.end(); ++it )
-        {
-            if( it->first == node || it->second == node )
-                to_delete.push(it);
-        }
-        // remove them ( popping from the stack will guarantee of deleting them from back to front
-        while( !to_delete.empty( ))
-        {
-            costs[(*to_delete.top())] = c;
-            arcs.erase( to_delete.top( ));
-            to_delete.pop();
-        }
-    
-    }
+    /// clearing its bit in the alive mask
+    /// subtracting the cost of its arcs from the stars of the other nodes
+    /// zeroing its arcs, so that no reduction needs to look at the mask
+    void RemoveNode( GraphNode node );
 };
 
 
@@ -244,6 +204,9 @@ void        getSubsetResult(                const GraphStruct& g, const Manifold
 void get_subsets( const MainStructure& main, const Module& module,
                   const std::vector< Match >& proposed,
                   std::vector< SubsetResult >& result, EdgeCost treshold );
+void get_subsets( const MainStructure& main, const TransformedModuleView& module,
+                  const std::vector< Match >& proposed,
+                  std::vector< SubsetResult >& result, EdgeCost treshold );
 
 void     normalize_costs( GraphStruct& g1, GraphStruct& g2, double max_distance );
 
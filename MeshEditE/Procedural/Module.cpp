@@ -7,10 +7,12 @@
 //
 
 #include "Module.h"
+#include "ModuleCache.h"
 #include "Test.h"
 #include <fstream>
 #include <streambuf>
 #include <iostream>
+#include <stdexcept>
 
 #include "rapidjson/document.h"
 
@@ -31,18 +33,27 @@ namespace Procedural{
 Module::Module( std::string path, std::string config, Moduletype mType ){
     cout << "trying to load file : " << path << endl;
     ifstream f( path );
-    assert( f.good() );
+    if( !f.good( )){ throw runtime_error( "cannot open " + path ); }
     
-    this->m = new Manifold();
+    if( ModuleCache::load( path, config, mType, *this )){ return; }
     
-    obj_load( path, *this->m );
-    bsphere( *m, bsphere_center, bsphere_radius );
-    BuildPoleInfo();
-    LoadPoleConfig( config );
+    this->m = new Manifold();
+    try{
+        if( !obj_load( path, *this->m )){ throw runtime_error( "cannot load " + path ); }
+        bsphere( *m, bsphere_center, bsphere_radius );
+        BuildPoleInfo();
+        LoadPoleConfig( config );
+    }
+    catch( ... ){
+        delete this->m;
+        this->m = NULL;
+        throw;
+    }
     
     this->skeleton = new Skeleton();
     this->skeleton->build( *m, this->poleSet );
-    this->skeleton->saveToFile("//Users//francescousai//Desktop//example.skel");
+    
+    ModuleCache::save( path, config, mType, *this );
 }
     
 Module::Module( Manifold &manifold, Moduletype mType ){
@@ -62,21 +73,27 @@ Module::Module( Manifold &manifold, Moduletype mType ){
 void Module::LoadPoleConfig( std::string path ){
     std::cout << path;
     std::ifstream t( path );
-    assert( t.good() );
+    if( !t.good( )){ throw runtime_error( "cannot open pole config " + path ); }
     std::string json( (std::istreambuf_iterator<char>(t)),
                      std::istreambuf_iterator<char>());
     
     rapidjson::Document d;
     d.Parse( json.c_str() );
+    if( d.HasParseError() || !d.IsObject() || !d.HasMember( "config" ) || !d["config"].IsArray( )){
+        throw runtime_error( "malformed pole config " + path );
+    }
     rapidjson::Value &tb = d["config"];
-    assert( tb.IsArray() );
     
     for( rapidjson::SizeType i = 0; i < tb.Size(); ++i ){
-        assert( tb[i].HasMember( "pole_id" ));
-        assert( tb[i].HasMember( "direction" )); // pole neighbor that expresses the preferred direction of alignment
-        assert( tb[i].HasMember( "bilateral" ));
-        assert( tb[i].HasMember( "active" ));
-        assert( tb[i].HasMember( "connect_to_self" ));
+        // direction is the pole neighbor that expresses the preferred direction of alignment
+        if( !tb[i].IsObject() ||
+            !tb[i].HasMember( "pole_id" )           || !tb[i]["pole_id"].IsInt()            ||
+            !tb[i].HasMember( "direction" )         || !tb[i]["direction"].IsInt()          ||
+            !tb[i].HasMember( "bilateral" )         || !tb[i]["bilateral"].IsBool()         ||
+            !tb[i].HasMember( "active" )            || !tb[i]["active"].IsBool()            ||
+            !tb[i].HasMember( "connect_to_self" )   || !tb[i]["connect_to_self"].IsBool( )){
+            throw runtime_error( "malformed entry " + to_string( i ) + " in pole config " + path );
+        }
         
         int     pole_id         = tb[i]["pole_id"].GetInt();
         int     direction       = tb[i]["direction"].GetInt();
@@ -88,28 +105,34 @@ void Module::LoadPoleConfig( std::string path ){
         for( VertexID pole : poleList ){
             if( done ){ assert(pole_id != pole.get_index()); continue; }
             if( pole_id == pole.get_index()){
-                poleInfoMap[pole].can_connect_to_self           = connect_to_self;
-                poleInfoMap[pole].isActive                      = active;
-                poleInfoMap[pole].anisotropy.is_bilateral       = bilateral;
+                PoleInfo pi                 = poleTable.at( pole );
+                pi.can_connect_to_self      = connect_to_self;
+                pi.isActive                 = active;
+                pi.anisotropy.is_bilateral  = bilateral;
                 
                 if( direction >= 0 ){
-                    poleInfoMap[pole].anisotropy.is_defined    = true;
+                    pi.anisotropy.is_defined    = true;
                     
                     VertexID neighbor = InvalidVertexID;
                     // find which neighbor is the one
                     for( Walker w = m->walker( pole ); (( !w.full_circle( )) && ( neighbor == InvalidVertexID )) ; w = w.circulate_vertex_ccw() ){
                         if( w.vertex().get_index() == direction ){ neighbor = w.vertex(); }
                     }
-                    assert( neighbor != InvalidVertexID );
+                    if( neighbor == InvalidVertexID ){
+                        throw runtime_error( "direction " + to_string( direction ) + " is not a neighbor of pole "
+                                             + to_string( pole_id ) + " in " + path );
+                    }
                         
                     Vec3d anisotropy( 0 );
                     getPoleAnisotropy( pole, anisotropy, neighbor );
-                    poleInfoMap[pole].anisotropy.direction = anisotropy;
+                    pi.anisotropy.direction = anisotropy;
                 }
+                poleTable.set( pole, pi );
                 done = true;
             }
         }
-        assert( done ); // means that a vertex with id equal to pole_id was found
+        // no pole with id equal to pole_id
+        if( !done ){ throw runtime_error( "vertex " + to_string( pole_id ) + " is not a pole in " + path ); }
         
     }
 
@@ -130,7 +153,7 @@ void Module::BuildPoleInfo(){
             pi.geometry.normal  = n;
             this->poleList.push_back( vid );
             this->poleSet.insert( vid );
-            this->poleInfoMap[vid] = pi;
+            this->poleTable.set( vid, pi );
         }
     }
 }
@@ -141,12 +164,12 @@ void Module::getPoleAnisotropy( VertexID pole, Vec3d &dir, VertexID neighbor ) c
     
     assert( is_pole( *m, pole ));
     
-    Plane p( poleInfoMap.at( pole ).geometry.pos, dir );
+    Plane p( poleTable.at( pole ).geometry.pos, dir );
     
     Vec3d point_to_project  = m->pos( neighbor );
-    Vec3d projected         = p.ortho( poleInfoMap.at( pole ).geometry.pos, point_to_project );
+    Vec3d projected         = p.ortho( poleTable.at( pole ).geometry.pos, point_to_project );
     
-    dir = projected - poleInfoMap.at( pole ).geometry.pos;
+    dir = projected - poleTable.at( pole ).geometry.pos;
     dir.normalize();
     // test :
     m->pos(neighbor) = projected;
@@ -156,51 +179,20 @@ void Module::getPoleAnisotropy( VertexID pole, Vec3d &dir, VertexID neighbor ) c
 Module& Module::getTransformedModule( const CGLA::Mat4x4d &T, bool transform_geometry )
 {
     Module *M = new Module();
-    M->m             = this->m;
-    M->poleList      = PoleList();
-    M->poleInfoMap   = PoleInfoMap();
+    M->m              = this->m;
+    M->poleList       = this->poleList;
+    M->poleSet        = this->poleSet;
+    M->poleTable      = this->poleTable;
     
     M->no_of_glueings = this->no_of_glueings;
-    M->bsphere_center = T.mul_3D_point( bsphere_center );
+    M->bsphere_center = bsphere_center;
     M->bsphere_radius = bsphere_radius;
+    M->placement      = placement;
     
-    for( VertexID vid : this->poleList ){
-        M->poleList.push_back( vid );
-        M->poleInfoMap[vid].original_id             = poleInfoMap[vid].original_id;
-        M->poleInfoMap[vid].geometry.pos            = T.mul_3D_point( poleInfoMap[vid].geometry.pos );
-        M->poleInfoMap[vid].geometry.normal         = mul_3D_dir( T, poleInfoMap[vid].geometry.normal );
-        M->poleInfoMap[vid].geometry.valence        = poleInfoMap[vid].geometry.valence;
-
-        M->poleInfoMap[vid].anisotropy.is_defined   = poleInfoMap[vid].anisotropy.is_defined;
-        M->poleInfoMap[vid].anisotropy.direction    = T.mul_3D_vector( poleInfoMap[vid].anisotropy.direction );
-        M->poleInfoMap[vid].anisotropy.is_bilateral = poleInfoMap[vid].anisotropy.is_bilateral;
-        
-        M->poleInfoMap[vid].age                     = poleInfoMap[vid].age;
-        M->poleInfoMap[vid].isFree                  = poleInfoMap[vid].isFree;
-        M->poleInfoMap[vid].can_connect_to_self     = poleInfoMap[vid].can_connect_to_self;
-        M->poleInfoMap[vid].isActive                = poleInfoMap[vid].isActive;
-        
-        bool assert_pos =
-            isnan( M->poleInfoMap[vid].geometry.pos[0] ) ||
-            isnan( M->poleInfoMap[vid].geometry.pos[1] ) ||
-            isnan( M->poleInfoMap[vid].geometry.pos[2] );
-        
-        bool assert_normal =
-            isnan( M->poleInfoMap[vid].geometry.normal[0] ) ||
-            isnan( M->poleInfoMap[vid].geometry.normal[1] ) ||
-            isnan( M->poleInfoMap[vid].geometry.normal[2] );
-        
-        if( M->poleInfoMap[vid].anisotropy.is_defined ){
-            bool assert_anis =
-                isnan( M->poleInfoMap[vid].anisotropy.direction[0] ) ||
-                isnan( M->poleInfoMap[vid].anisotropy.direction[1] ) ||
-                isnan( M->poleInfoMap[vid].anisotropy.direction[2] );
-            assert( !assert_anis );
-        }
-        
-        assert( !assert_pos );
-        assert( !assert_normal );
-    }
+    M->skeleton = new Skeleton();
+    M->skeleton->copyNew( *skeleton );
+    
+    M->transform( T );
     
     if( transform_geometry ){
         for( VertexID v : m->vertices()){
@@ -208,37 +200,46 @@ Module& Module::getTransformedModule( const CGLA::Mat4x4d &T, bool transform_geo
         }
     }
     
-    assert( M->poleInfoMap.size() == this->poleInfoMap.size( ));
-    
-    M->skeleton = new Skeleton();    
-    M->skeleton->copyNew( *skeleton );
-    M->skeleton->transform( T );
+    assert( M->poleTable.size() == this->poleTable.size( ));
     
     return *M;
 }
+
+void Module::deleteKeepingMesh( Module *M )
+{
+    assert( M != NULL );
+    // the skeleton has no destructor, its collision hierarchy is allocated by copyNew
+    delete M->skeleton->cd_hierarchy;
+    delete M->skeleton;
+    delete M;
+}
+    
+void Module::transform( const CGLA::Mat4x4d &T ){
+    bsphere_center = T.mul_3D_point( bsphere_center );
+    placement      = T * placement;
+    poleTable.transform( T );
+    skeleton->transform( T );
+}
     
-void Module::reAlignIDs(HMesh::VertexIDRemap &remapper){
+void Module::reAlignIDs( const VertexIDTable &table ){
     // realign poleList
-    PoleInfoMap p;
     for( int i = 0; i < poleList.size(); ++i ){
-        VertexID newID = remapper[poleList[i]];
-        p[newID] = poleInfoMap[poleList[i]];
-        poleList[i] = newID;
+        poleList[i] = remapped( table, poleList[i] );
     }
-    poleInfoMap = std::move( p );
-    Skeleton* temp = skeleton;
-    skeleton = new Skeleton();
-    skeleton->copyAndRealignIDs( *temp, remapper );
-//    skeleton->reAlignIDs( remapper );
+    PoleSet realigned;
+    for( VertexID v : poleSet ){ realigned.insert( remapped( table, v )); }
+    poleSet = std::move( realigned );
+    poleTable.reAlignIDs( table );
+    skeleton->reAlignIDs( table );
 }
 
 const PoleInfo& Module::getPoleInfo( HMesh::VertexID p ) const{
-    assert(poleInfoMap.count(p) > 0);
-    return poleInfoMap.at(p);
+    assert( poleTable.count( p ) > 0 );
+    return poleTable.at( p );
 }
     
 bool Module::isPole( HMesh::VertexID v ){
-    return (( find( poleList.begin(), poleList.end(), v ) != poleList.end()) && ( poleInfoMap.count(v) > 0 ) );
+    return ( poleTable.count( v ) > 0 );
 }
     
 const Skeleton& Module::getSkeleton() const{
@@ -248,12 +249,16 @@ const Skeleton& Module::getSkeleton() const{
 /*** STATIC ***/
 // this should be elsewhere, but I don't know where to put it.
 bool Module::poleCanMatch( const PoleInfo& p1, const PoleInfo& p2){
+#ifdef TRACE
     cout << "testing : " << p1.moduleType << " -> " << p1.original_id << " with "
                          << p2.moduleType << " -> " << p2.original_id << endl;
+#endif
 
     // test valence
     if( p1.geometry.valence != p2.geometry.valence ) {
+#ifdef TRACE
         cout << "KO for valence (" << p1.geometry.valence << ", " << p2.geometry.valence << " )" << endl;
+#endif
         return false;
     }
 
@@ -261,7 +266,9 @@ bool Module::poleCanMatch( const PoleInfo& p1, const PoleInfo& p2){
     if( p1.moduleType == p2.moduleType ){
         if( p1.original_id == p2.original_id ){
             if( !( p1.can_connect_to_self && p2.can_connect_to_self )){
+#ifdef TRACE
                 cout << "KO connect_to_self" << endl;
+#endif
                 return false;
             }
         }
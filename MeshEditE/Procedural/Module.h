@@ -26,6 +26,7 @@
 
 #include "pam_skeleton.h"
 #include "collision_detection.h"
+#include "PoleTable.h"
 
 namespace Procedural{
     
@@ -43,56 +44,37 @@ enum PoleLabel {
     AllP     = 127      // this is 11111111 it will match each value
 };
 
-typedef unsigned int Moduletype;
-    
-struct PoleAnisotropyInfo{
-    CGLA::Vec3d     direction;
-    bool            is_defined   = false;
-    bool            is_bilateral = false ;
-};
-    
-struct PoleGeometryInfo{
-    unsigned int    valence;
-    CGLA::Vec3d     pos;
-    CGLA::Vec3d     normal;
-};
-    
-
-    
-struct PoleInfo{
-    HMesh::VertexID     original_id;
-    PoleAnisotropyInfo  anisotropy;
-    PoleGeometryInfo    geometry;
-    Moduletype          moduleType  = 0;     // an identifier for the module's type
-
-    int                 age;                 // pole's starting age
-    bool                isFree      = true;
-    bool                isActive    = true;
-    bool                can_connect_to_self = true; /* can connect to an instance of the 
-                                                     same pole on another module of the 
-                                                     same exact type ( same file ) */
-};
-    
-typedef std::map<HMesh::VertexID, PoleInfo>             PoleInfoMap;
 typedef std::vector< HMesh::VertexID>                   PoleList;
 typedef std::set< HMesh::VertexID >                     PoleSet;
 
 class Module{
+    friend class ModuleCache;
     
 public:
-         // this will instantiate the internal manifold structure and pole info using obj_load
+         // this will instantiate the internal manifold structure and pole info using obj_load,
+         // or from the module cache if it is up to date ( see ModuleCache ).
+         // throws std::runtime_error if the files are missing or malformed
         Module () { m = NULL; }
         Module( std::string path, std::string config, Moduletype mType );
         Module( HMesh::Manifold &manifold, Moduletype mType );
     
+        // returns a new copy of the module, to be used only when the module has to be owned by someone
+        // ( e.g. the main structure ). For evaluating poses use a TransformedModuleView
         Module& getTransformedModule( const CGLA::Mat4x4d &T, bool transform_geometry = false );
-        void reAlignIDs( HMesh::VertexIDRemap &remapper );
+        // frees M and its skeleton. M->m is left as it is : it is shared with the module M was
+        // copied from ( see getTransformedModule ) or it is owned by someone else
+        static void deleteKeepingMesh( Module *M );
+        // transforms in place the poles and the skeleton, the manifold is not touched.
+        // T is accumulated into placement
+        void transform( const CGLA::Mat4x4d &T );
+        // in place, the skeleton is not copied
+        void reAlignIDs( const VertexIDTable &table );
     
         const PoleInfo&    getPoleInfo( HMesh::VertexID p ) const;
         bool isPole( HMesh::VertexID v );
         const Skeleton& getSkeleton() const;
 
-        inline const PoleInfoMap& getPoleInfoMap()const{ return poleInfoMap; }
+        inline const PoleTable& getPoleTable()const{ return poleTable; }
     
         static bool poleCanMatch( const PoleInfo& p1, const PoleInfo& p2);
 private:
@@ -113,9 +95,11 @@ public:
 
     CGLA::Vec3d         bsphere_center;
     double              bsphere_radius;
+    // brings m into the space of the poles and of the skeleton
+    CGLA::Mat4x4d       placement = CGLA::identity_Mat4x4d();
     
 private :
-    PoleInfoMap         poleInfoMap;
+    PoleTable           poleTable;
     Skeleton            *skeleton;
 
     };
@@ -0,0 +1,474 @@
+//
+//  ModuleCache.cpp
+//  MeshEditE
+//
+
+#include "ModuleCache.h"
+#include "Module.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <fstream>
+#include <iterator>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <functional>
+
+using namespace std;
+using namespace HMesh;
+using namespace CGLA;
+
+namespace Procedural{
+
+namespace {
+
+    const char      MAGIC[8] = { 'P', 'A', 'M', 'C', 'A', 'C', 'H', 'E' };
+
+    struct Header{
+        char        magic[8];
+        uint32_t    version;
+        uint32_t    module_type;
+        uint64_t    payload_size;
+        uint64_t    config_path_hash;
+        uint64_t    config_hash;        // of the contents of the config file
+        uint64_t    checksum;
+    };
+
+    // FNV-1a
+    uint64_t checksum( const char* data, size_t size ){
+        uint64_t h = 14695981039346656037ull;
+        for( size_t i = 0; i < size; ++i ){
+            h ^= static_cast<unsigned char>( data[i] );
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+    uint64_t checksum( const string& s ){ return checksum( s.data(), s.size( )); }
+
+    // a missing config ( or none at all ) hashes as an empty one
+    uint64_t configHash( const string& config_path ){
+        if( config_path.empty( )){ return checksum( string( )); }
+        ifstream f( config_path, ifstream::binary );
+        string contents(( istreambuf_iterator< char >( f )), istreambuf_iterator< char >( ));
+        return checksum( contents );
+    }
+
+    /*=========================================================================*
+     *                     WRITER / READER                                     *
+     *=========================================================================*/
+
+    class Writer{
+    public:
+        template< typename T >
+        void put( const T& v ){
+            const char* p = reinterpret_cast< const char* >( &v );
+            buffer.insert( buffer.end(), p, p + sizeof( T ));
+        }
+        void putSize( size_t s )            { put( static_cast< uint64_t >( s )); }
+        void putVec( const Vec3d& v )       { put( v[0] ); put( v[1] ); put( v[2] ); }
+        void putBall( const Ball& b )       { putVec( b.center ); put( b.radius ); }
+        void putID( VertexID v )            { putSize( v.get_index( )); }
+        template< typename T >
+        void putSizes( const T& container ) {
+            putSize( container.size( ));
+            for( size_t s : container ){ putSize( s ); }
+        }
+
+        vector< char > buffer;
+    };
+
+    class Reader{
+    public:
+        Reader( const char* data, size_t size ) : p( data ), end( data + size ) {}
+
+        template< typename T >
+        T get(){
+            T v = T();
+            if( !ok || static_cast< size_t >( end - p ) < sizeof( T )){ ok = false; return v; }
+            memcpy( &v, p, sizeof( T ));
+            p += sizeof( T );
+            return v;
+        }
+        size_t  getSize()   { return static_cast< size_t >( get< uint64_t >( )); }
+        // sizes of containers, rejects sizes that cannot fit in what is left of the file
+        size_t  getCount( size_t min_item_size ){
+            size_t n = getSize();
+            if( n > static_cast< size_t >( end - p ) / min_item_size ){ ok = false; return 0; }
+            return n;
+        }
+        Vec3d   getVec()    { double x = get<double>(), y = get<double>(), z = get<double>(); return Vec3d( x, y, z ); }
+        Ball    getBall()   { Ball b; b.center = getVec(); b.radius = get<double>(); return b; }
+
+        bool        ok = true;
+        const char* p;
+        const char* end;
+    };
+
+    /*=========================================================================*
+     *                     SKELETON                                            *
+     *=========================================================================*/
+
+    void writeSkeleton( Writer& w, const Skeleton& s ){
+        w.putSize( s.nodes.size( ));
+        for( const SkelNode& n : s.nodes ){
+            w.putSize( n.ID );
+            w.put( static_cast< int32_t >( n.type ));
+            w.putBall( n.ball );
+            w.putSizes( n.neighbors );
+            w.putSize( n.boneID );
+        }
+        w.putSize( s.bones.size( ));
+        for( const SkelBone& b : s.bones ){
+            w.putSize( b.ID );
+            w.putSizes( b.nodes );
+        }
+        for( const map< VertexID, NodeID >* m : { &s.poleToNode, &s.junctionSingularityToNode } ){
+            w.putSize( m->size( ));
+            for( const auto& item : *m ){ w.putID( item.first ); w.putSize( item.second ); }
+        }
+
+        bool has_cd = ( s.cd_hierarchy != NULL );
+        w.put( static_cast< uint8_t >( has_cd ));
+        if( has_cd ){
+            w.putBall( s.cd_hierarchy->ball );
+            w.putSize( s.cd_hierarchy->joints.size( ));
+            for( const auto& item : s.cd_hierarchy->joints ){
+                w.putSize( item.first );
+                w.putSize( item.second.ID );
+                w.putBall( item.second.ball );
+                w.putSizes( item.second.incidentBones );
+            }
+            w.putSize( s.cd_hierarchy->bones.size( ));
+            for( const auto& item : s.cd_hierarchy->bones ){
+                w.putSize( item.first );
+                w.putSize( item.second.ID );
+                w.putBall( item.second.ball );
+                w.putSizes( item.second.nodes );
+            }
+        }
+
+        w.putSize( s.bvh.tree.size( ));
+        for( const BallTreeNode& n : s.bvh.tree ){
+            w.putBall( n.ball );
+            w.put( static_cast< int32_t >( n.left ));
+            w.put( static_cast< int32_t >( n.right ));
+            w.put( static_cast< int32_t >( n.parent ));
+            w.putSize( n.first );
+            w.putSize( n.count );
+        }
+        w.putSizes( s.bvh.items );
+        w.putSize( s.bvh.leafOf.size( ));
+        for( int l : s.bvh.leafOf ){ w.put( static_cast< int32_t >( l )); }
+        w.put( static_cast< int32_t >( s.bvh.root ));
+
+        w.putBall( s.bounding_sphere );
+        w.put( static_cast< uint8_t >( s.valid ));
+    }
+
+    template< typename T >
+    void readSizes( Reader& r, T& container ){
+        size_t n = r.getCount( sizeof( uint64_t ));
+        for( size_t i = 0; i < n; ++i ){ container.insert( container.end(), r.getSize( )); }
+    }
+
+    bool readSkeleton( Reader& r, const vector< VertexID >& ids, Skeleton& s ){
+        auto getID = [&](){
+            size_t i = r.getSize();
+            if( i >= ids.size( )){ r.ok = false; return InvalidVertexID; }
+            return ids[i];
+        };
+
+        s.nodes.resize( r.getCount( 1 ));
+        for( SkelNode& n : s.nodes ){
+            n.ID        = r.getSize();
+            n.type      = static_cast< SkelNodeType >( r.get< int32_t >( ));
+            n.ball      = r.getBall();
+            readSizes( r, n.neighbors );
+            n.boneID    = r.getSize();
+        }
+        s.bones.resize( r.getCount( 1 ));
+        for( SkelBone& b : s.bones ){
+            b.ID = r.getSize();
+            readSizes( r, b.nodes );
+        }
+        for( map< VertexID, NodeID >* m : { &s.poleToNode, &s.junctionSingularityToNode } ){
+            size_t n = r.getCount( 2 * sizeof( uint64_t ));
+            for( size_t i = 0; i < n; ++i ){
+                VertexID v  = getID();
+                ( *m )[v]   = r.getSize();
+            }
+        }
+
+        delete s.cd_hierarchy;
+        s.cd_hierarchy = NULL;
+        if( r.get< uint8_t >( )){
+            s.cd_hierarchy = new ShapeBall();
+            s.cd_hierarchy->ball = r.getBall();
+            size_t no_joints = r.getCount( 1 );
+            for( size_t i = 0; i < no_joints; ++i ){
+                BranchingBall& j = s.cd_hierarchy->joints[r.getSize()];
+                j.ID    = r.getSize();
+                j.ball  = r.getBall();
+                readSizes( r, j.incidentBones );
+            }
+            size_t no_bones = r.getCount( 1 );
+            for( size_t i = 0; i < no_bones; ++i ){
+                BoneBall& b = s.cd_hierarchy->bones[r.getSize()];
+                b.ID    = r.getSize();
+                b.ball  = r.getBall();
+                readSizes( r, b.nodes );
+            }
+        }
+
+        s.bvh.tree.resize( r.getCount( 1 ));
+        for( BallTreeNode& n : s.bvh.tree ){
+            n.ball      = r.getBall();
+            n.left      = r.get< int32_t >();
+            n.right     = r.get< int32_t >();
+            n.parent    = r.get< int32_t >();
+            n.first     = r.getSize();
+            n.count     = r.getSize();
+        }
+        s.bvh.items.clear();
+        readSizes( r, s.bvh.items );
+        s.bvh.leafOf.resize( r.getCount( sizeof( int32_t )));
+        for( int& l : s.bvh.leafOf ){ l = r.get< int32_t >(); }
+        s.bvh.root = r.get< int32_t >();
+
+        s.bounding_sphere   = r.getBall();
+        s.valid             = ( r.get< uint8_t >() != 0 );
+        return r.ok;
+    }
+
+    /*=========================================================================*
+     *                     FILES                                               *
+     *=========================================================================*/
+
+    // 0 if the file does not exist
+    time_t modificationTime( const string& path ){
+        struct stat st;
+        if( path.empty() || stat( path.c_str(), &st ) != 0 ){ return 0; }
+        return st.st_mtime;
+    }
+
+    class MappedFile{
+    public:
+        MappedFile( const string& path ){
+            int fd = open( path.c_str(), O_RDONLY );
+            if( fd < 0 ){ return; }
+            struct stat st;
+            if( fstat( fd, &st ) == 0 && st.st_size > 0 ){
+                void* p = mmap( NULL, static_cast< size_t >( st.st_size ), PROT_READ, MAP_PRIVATE, fd, 0 );
+                if( p != MAP_FAILED ){
+                    data = static_cast< const char* >( p );
+                    size = static_cast< size_t >( st.st_size );
+                }
+            }
+            close( fd );
+        }
+        ~MappedFile(){
+            if( data != NULL ){ munmap( const_cast< char* >( data ), size ); }
+        }
+
+        const char* data = NULL;
+        size_t      size = 0;
+    };
+}
+
+/*=========================================================================*
+ *                     MODULE CACHE                                        *
+ *=========================================================================*/
+
+string ModuleCache::cachePath( const string& obj_path, const string& config_path ){
+    char config_key[17];
+    snprintf( config_key, sizeof( config_key ), "%016llx", static_cast< unsigned long long >( checksum( config_path )));
+    return obj_path + "." + config_key + ".pamcache";
+}
+
+bool ModuleCache::save( const string& obj_path, const string& config_path, Moduletype mType, const Module& module ){
+    const Manifold& m = *module.m;
+    // vertex ids are stored as indices, they must be 0..n-1 as after obj_load
+    if( m.allocated_vertices() != m.no_vertices( )){
+        cout << "module cache : " << obj_path << " has unused vertex slots, not cached" << endl;
+        return false;
+    }
+
+    Writer w;
+    // mesh
+    w.putSize( m.no_vertices( ));
+    for( VertexID v : m.vertices( )){ w.putVec( m.pos( v )); }
+    w.putSize( m.no_faces( ));
+    vector< int32_t > indices;
+    for( FaceID f : m.faces( )){
+        int32_t n = 0;
+        for( Walker wf = m.walker( f ); !wf.full_circle(); wf = wf.circulate_face_ccw( )){
+            indices.push_back( static_cast< int32_t >( wf.vertex().get_index( )));
+            ++n;
+        }
+        w.put( n );
+    }
+    w.putSize( indices.size( ));
+    for( int32_t i : indices ){ w.put( i ); }
+
+    // module
+    w.putVec( module.bsphere_center );
+    w.put( module.bsphere_radius );
+    w.putSize( module.poleList.size( ));
+    for( VertexID p : module.poleList ){ w.putID( p ); }
+
+    const PoleTable& table = module.poleTable;
+    w.putSize( table.size( ));
+    for( PoleTable::Slot s = 0; s < table.size(); ++s ){
+        const PoleInfo& pi = table.info( s );
+        w.putID( table.id( s ));
+        w.putID( pi.original_id );
+        w.putVec( pi.anisotropy.direction );
+        w.put( static_cast< uint8_t >( pi.anisotropy.is_defined ));
+        w.put( static_cast< uint8_t >( pi.anisotropy.is_bilateral ));
+        w.put( static_cast< uint32_t >( pi.geometry.valence ));
+        w.putVec( pi.geometry.pos );
+        w.putVec( pi.geometry.normal );
+        w.put( static_cast< uint32_t >( pi.moduleType ));
+        w.put( static_cast< int32_t >( pi.age ));
+        w.put( static_cast< uint8_t >( pi.isFree ));
+        w.put( static_cast< uint8_t >( pi.isActive ));
+        w.put( static_cast< uint8_t >( pi.can_connect_to_self ));
+    }
+
+    writeSkeleton( w, *module.skeleton );
+
+    Header h;
+    memcpy( h.magic, MAGIC, sizeof( MAGIC ));
+    h.version           = VERSION;
+    h.module_type       = static_cast< uint32_t >( mType );
+    h.payload_size      = w.buffer.size();
+    h.config_path_hash  = checksum( config_path );
+    h.config_hash       = configHash( config_path );
+    h.checksum          = checksum( w.buffer.data(), w.buffer.size( ));
+
+    // written to a temporary file and renamed, a crash never leaves a truncated cache. The name is
+    // unique per thread, the same OBJ can be loaded concurrently by more than one toolbox entry
+    string path = cachePath( obj_path, config_path );
+    string tmp  = path + ".tmp" + to_string( getpid( )) + "_" + to_string( hash< thread::id >()( this_thread::get_id( )));
+    ofstream f( tmp, ofstream::binary | ofstream::trunc );
+    if( !f.is_open( )){
+        cout << "module cache : cannot write " << path << endl;
+        return false;
+    }
+    f.write( reinterpret_cast< const char* >( &h ), sizeof( h ));
+    f.write( w.buffer.data(), w.buffer.size( ));
+    f.close();
+    if( !f || rename( tmp.c_str(), path.c_str( )) != 0 ){
+        cout << "module cache : cannot write " << path << endl;
+        remove( tmp.c_str( ));
+        return false;
+    }
+    return true;
+}
+
+bool ModuleCache::load( const string& obj_path, const string& config_path, Moduletype mType, Module& module ){
+    string path         = cachePath( obj_path, config_path );
+    time_t cache_time   = modificationTime( path );
+    if( cache_time == 0 ){ return false; }
+    if( cache_time < modificationTime( obj_path ) || cache_time < modificationTime( config_path )){
+        cout << "module cache : " << path << " is older than its sources" << endl;
+        return false;
+    }
+
+    MappedFile file( path );
+    if( file.data == NULL || file.size < sizeof( Header )){ return false; }
+    Header h;
+    memcpy( &h, file.data, sizeof( Header ));
+    const char* payload = file.data + sizeof( Header );
+    if( memcmp( h.magic, MAGIC, sizeof( MAGIC )) != 0 || h.version != VERSION ||
+        h.payload_size != file.size - sizeof( Header ) ||
+        h.checksum != checksum( payload, static_cast< size_t >( h.payload_size ))){
+        cout << "module cache : " << path << " is invalid or from another version" << endl;
+        return false;
+    }
+    // the file name is only a hash of the config path, the header tells if it is really this config
+    if( h.config_path_hash != checksum( config_path ) || h.config_hash != configHash( config_path ) ||
+        h.module_type != static_cast< uint32_t >( mType )){
+        cout << "module cache : " << path << " was built from another config" << endl;
+        return false;
+    }
+
+    Reader r( payload, static_cast< size_t >( h.payload_size ));
+
+    // mesh
+    size_t no_vertices = r.getCount( 3 * sizeof( double ));
+    vector< Vec3d > positions( no_vertices );
+    for( Vec3d& p : positions ){ p = r.getVec(); }
+    size_t no_faces = r.getCount( sizeof( int32_t ));
+    vector< int > faces( no_faces );
+    for( int& n : faces ){ n = r.get< int32_t >(); }
+    size_t no_indices = r.getCount( sizeof( int32_t ));
+    vector< int > indices( no_indices );
+    for( int& i : indices ){
+        i = r.get< int32_t >();
+        if( i < 0 || static_cast< size_t >( i ) >= no_vertices ){ r.ok = false; }
+    }
+    if( !r.ok ){ return false; }
+
+    Manifold* m = new Manifold();
+    m->build( no_vertices, reinterpret_cast< const double* >( positions.data( )), no_faces, faces.data(), indices.data( ));
+    vector< VertexID > ids;
+    ids.reserve( no_vertices );
+    for( VertexID v : m->vertices( )){ ids.push_back( v ); }
+
+    auto getID = [&](){
+        size_t i = r.getSize();
+        if( i >= ids.size( )){ r.ok = false; return InvalidVertexID; }
+        return ids[i];
+    };
+
+    // module
+    Vec3d       bsphere_center  = r.getVec();
+    double      bsphere_radius  = r.get< double >();
+    PoleList    poleList( r.getCount( sizeof( uint64_t )));
+    for( VertexID& p : poleList ){ p = getID(); }
+
+    PoleTable   poleTable;
+    size_t      no_poles = r.getCount( sizeof( uint64_t ));
+    for( size_t i = 0; i < no_poles && r.ok; ++i ){
+        VertexID pole                   = getID();
+        PoleInfo pi;
+        pi.original_id                  = getID();
+        pi.anisotropy.direction         = r.getVec();
+        pi.anisotropy.is_defined        = ( r.get< uint8_t >() != 0 );
+        pi.anisotropy.is_bilateral      = ( r.get< uint8_t >() != 0 );
+        pi.geometry.valence             = r.get< uint32_t >();
+        pi.geometry.pos                 = r.getVec();
+        pi.geometry.normal              = r.getVec();
+        pi.moduleType                   = r.get< uint32_t >();
+        pi.age                          = r.get< int32_t >();
+        pi.isFree                       = ( r.get< uint8_t >() != 0 );
+        pi.isActive                     = ( r.get< uint8_t >() != 0 );
+        pi.can_connect_to_self          = ( r.get< uint8_t >() != 0 );
+        if( r.ok ){ poleTable.set( pole, pi ); }
+    }
+
+    Skeleton* skeleton = new Skeleton();
+    if( !r.ok || !readSkeleton( r, ids, *skeleton ) || r.p != r.end ){
+        cout << "module cache : " << path << " is malformed" << endl;
+        delete skeleton;
+        delete m;
+        return false;
+    }
+
+    module.m                = m;
+    module.bsphere_center   = bsphere_center;
+    module.bsphere_radius   = bsphere_radius;
+    module.poleList         = poleList;
+    module.poleSet          = PoleSet( poleList.begin(), poleList.end( ));
+    module.poleTable        = poleTable;
+    module.skeleton         = skeleton;
+    return true;
+}
+
+}
@@ -0,0 +1,40 @@
+//
+//  ModuleCache.h
+//  MeshEditE
+//
+
+#ifndef __MeshEditE__ModuleCache__
+#define __MeshEditE__ModuleCache__
+
+#include <stdio.h>
+#include <string>
+
+#include "PoleTable.h"
+
+namespace Procedural{
+
+class Module;
+
+/// Binary cache of a Module loaded from OBJ + pole config : mesh, pole table, skeleton and
+/// collision hierarchy, so that loading a toolbox skips obj_load, the pole analysis and
+/// Skeleton::build. The cache lives next to the OBJ, one file per pole config
+/// ( <obj path>.<hash of the config path>.pamcache ), since the same OBJ can be used by several
+/// toolbox entries with different configs. It is read with mmap and it is used only if it has the
+/// current version, a valid checksum, it is newer than the OBJ and it was built from a config with
+/// the same path, the same contents and for the same module type.
+class ModuleCache{
+public:
+    static const unsigned int VERSION = 2;
+
+    static std::string  cachePath( const std::string& obj_path, const std::string& config_path );
+    // true if module has been filled from a valid cache
+    static bool         load( const std::string& obj_path, const std::string& config_path, Moduletype mType,
+                              Module& module );
+    // failures ( e.g. read only folders ) are reported and ignored
+    static bool         save( const std::string& obj_path, const std::string& config_path, Moduletype mType,
+                              const Module& module );
+};
+
+}
+
+#endif /* defined(__MeshEditE__ModuleCache__) */
@@ -7,6 +7,7 @@
 //
 
 #include "Algorithms.h"
+#include <MeshEditE/HMeshParallelKit.h>
 
 using namespace std;
 using namespace CGLA;
@@ -104,88 +105,90 @@ void selected_vertices_cotangent_weights_laplacian( HMesh::Manifold&m, vector< V
 // weighted laplacian smoothing with inverse distance as weight
 void inverse_distance_laplacian_smoothing( HMesh::Manifold& am )
 {
-    map< VertexID, Vec3d > new_pos;
+    ManifoldCSR csr( am );
+    inverse_distance_laplacian_smoothing( am, csr, 1 );
+}
+            
+void inverse_distance_laplacian_smoothing( HMesh::Manifold& am, const ManifoldCSR& csr, int iterations )
+{
+    vector< Vec3d > pos, new_pos;
+    csr.gather_positions( am, pos );
+    new_pos.resize( pos.size( ));
     
-    for( VertexID vid : am.vertices( ) )
+    for( int i = 0; i < iterations; ++i )
     {
-        double weight_sum   = 0.0;
-        Walker w            = am.walker( vid );
-        Vec3d vid_pos       = am.pos( vid );
-        new_pos[vid]        = Vec3d( 0 );
-        
-        // iterate the one-ring of the vertex vid
-        for( ; !w.full_circle( ); w = w.circulate_vertex_ccw( ) )
+        parallel_for( size_t( 0 ), csr.no_vertices(), [&]( size_t v )
         {
-            Vec3d   neighbor_pos    = am.pos( w.vertex() );
-            double  length          = ( vid_pos - neighbor_pos ).length();
+            double  weight_sum  = 0.0;
+            Vec3d   sum( 0 );
             
-            assert( vid_pos != neighbor_pos );
-            assert( !isnan( length ));
-            
-            double  weight          = 1.0 / length;
-            new_pos[vid]   += ( neighbor_pos * weight );
-            weight_sum += weight;
-        }
-        
-        new_pos[vid] /= weight_sum;
+            // iterate the one-ring of the vertex v
+            for( int s = csr.offsets[v]; s < csr.offsets[v+1]; ++s )
+            {
+                const Vec3d&    neighbor_pos    = pos[csr.neighbors[s]];
+                double          length          = ( pos[v] - neighbor_pos ).length();
+                
+                assert( pos[v] != neighbor_pos );
+                assert( !isnan( length ));
+                
+                double  weight  = 1.0 / length;
+                sum            += ( neighbor_pos * weight );
+                weight_sum     += weight;
+            }
+            new_pos[v] = sum / weight_sum;
+        });
+        swap( pos, new_pos );
     }
     // update coordinates
-    for( VertexID vid : am.vertices( ) )  { am.pos( vid ) = new_pos[vid]; }
+    csr.scatter_positions( pos, am );
 }
 
 // weighted laplacian smoothing with cotangets as weight
-void cotangent_weights_laplacian_smoothing( HMesh::Manifold& am)
+void cotangent_weights_laplacian_smoothing( HMesh::Manifold& am )
 {
-    map< VertexID, Vec3d > new_pos;
+    ManifoldCSR csr( am );
+    cotangent_weights_laplacian_smoothing( am, csr, 1 );
+}
+            
+void cotangent_weights_laplacian_smoothing( HMesh::Manifold& am, const ManifoldCSR& csr, int iterations )
+{
+    vector< Vec3d > pos, new_pos, centroids;
+    csr.gather_positions( am, pos );
+    new_pos.resize( pos.size( ));
     
-    for( VertexID vid : am.vertices( ) )
+    for( int i = 0; i < iterations; ++i )
     {
-        double weight_sum   = 0.0;
-        Walker w            = am.walker( vid );
-        Vec3d vid_pos       = am.pos(vid);
-        new_pos[vid]        = Vec3d( 0 );
+        // the two faces of each edge, computed once per iteration instead of once per halfedge
+        csr.loop_centroids( pos, centroids );
         
-        for ( ; !w.full_circle(); w = w.circulate_vertex_ccw( ))
+        parallel_for( size_t( 0 ), csr.no_vertices(), [&]( size_t v )
         {
-            Vec3d   neighbor_pos    = am.pos(w.vertex());
-            double  length          = ( vid_pos - neighbor_pos ).length();
-            assert( !isnan( length ) && length > 0 );
-            HalfEdgeID  curr_he     = w.halfedge();
-            HalfEdgeID  twin_he     = w.opp().halfedge();
-            
-            Vec3d   face_1_centroid(0);
-            Vec3d   face_2_centroid(0);
+            double  weight_sum  = 0.0;
+            Vec3d   sum( 0 );
             
-            Vec3d   edge_midpoint( ( vid_pos[0] + neighbor_pos[0] )/2.0,
-                                  ( vid_pos[1] + neighbor_pos[1] )/2.0,
-                                  ( vid_pos[2] + neighbor_pos[2] )/2.0);
-            Walker wf1 = am.walker(curr_he);
-            Walker wf2 = am.walker(twin_he);
-            // calculate centroid of the first face
-            for ( ; !wf1.full_circle(); wf1 = wf1.next( )) {
-                face_1_centroid += am.pos( wf1.vertex( ));
-            }
-            face_1_centroid /= (double)wf1.no_steps();
-            // calculate centroid of the second face
-            for ( ; !wf2.full_circle(); wf2 = wf2.next( )) {
-                face_2_centroid += am.pos( wf2.vertex( ));
+            for( int s = csr.offsets[v]; s < csr.offsets[v+1]; ++s )
+            {
+                const Vec3d&    neighbor_pos    = pos[csr.neighbors[s]];
+                double          length          = ( pos[v] - neighbor_pos ).length();
+                assert( !isnan( length ) && length > 0 );
+                
+                Vec3d   edge_midpoint   = ( pos[v] + neighbor_pos ) / 2.0;
+                // calculate heights as distance between the edge midpoint and the face's centroid
+                double h1 = ( edge_midpoint - centroids[csr.left_loop[s]] ).length();
+                double h2 = ( edge_midpoint - centroids[csr.right_loop[s]] ).length();
+                assert( !isnan( h1 ) && h1 > 0);
+                assert( !isnan( h2 ) && h2 > 0);
+                // calculate weight and new position of the vertex
+                double weight    = ( h1 + h2 ) / length;
+                weight_sum      += weight;
+                sum             += ( neighbor_pos * weight );
             }
-            face_2_centroid /= (double)wf2.no_steps();
-            // calculate heights as distance between the edge midpoint and the face's centroid
-            double h1 = ( edge_midpoint - face_1_centroid ).length();
-            double h2 = ( edge_midpoint - face_2_centroid ).length();
-            assert( !isnan( h1 ) && h1 > 0);
-            assert( !isnan( h2 ) && h2 > 0);
-            // calculate weight and new position of the vertex
-            double weight    = ( h1 + h2 ) / length;
-            weight_sum      += weight;
-            new_pos[vid]    += ( neighbor_pos * weight );
-        }
-        
-        new_pos[vid] /= weight_sum;
+            new_pos[v] = sum / weight_sum;
+        });
+        swap( pos, new_pos );
     }
     // update coordinates
-    for( VertexID vid : am.vertices( ) )  { am.pos( vid ) = new_pos[vid]; }
+    csr.scatter_positions( pos, am );
 }
             
             
@@ -12,6 +12,7 @@
 #include <iostream>
 #include <GEL/HMesh/Manifold.h>
 #include <polarize.h>
+#include <MeshEditE/ManifoldCSR.h>
 
 namespace Procedural{
     namespace Operations{
@@ -21,6 +22,9 @@ namespace Procedural{
     void selected_vertices_inverse_distance_laplacian   ( HMesh::Manifold&m, std::vector< HMesh::VertexID > vs );
     void inverse_distance_laplacian_smoothing           ( HMesh::Manifold& am );
     void cotangent_weights_laplacian_smoothing          ( HMesh::Manifold& am );
+    // repeated smoothing on a topology that does not change, csr must be a snapshot of am
+    void inverse_distance_laplacian_smoothing           ( HMesh::Manifold& am, const ManifoldCSR& csr, int iterations );
+    void cotangent_weights_laplacian_smoothing          ( HMesh::Manifold& am, const ManifoldCSR& csr, int iterations );
     void along_spines                                   ( HMesh::Manifold& m,
                                                           HMesh::HalfEdgeAttributeVector<EdgeInfo> &edge_info );
 //    void along_ribs                                     ( HMesh::Manifold& m,
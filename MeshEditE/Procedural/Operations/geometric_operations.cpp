@@ -9,10 +9,10 @@
 #include "geometric_operations.h"
 #include "polarize.h"
 #include <MeshEditE/Procedural/Helpers/geometric_properties.h>
-#include <MeshEditE/Procedural/Helpers/plane.h>
+#include <MeshEditE/Procedural/Helpers/Plane.h>
 #include <MeshEditE/Procedural/Operations/Algorithms.h>
 #include <MeshEditE/Procedural/Operations/Algorithms.h>
-#include "test.h"
+#include "Test.h"
 
 using namespace HMesh;
 using namespace CGLA;
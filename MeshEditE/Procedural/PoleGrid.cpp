@@ -0,0 +1,68 @@
+//
+//  PoleGrid.cpp
+//  MeshEditE
+//
+
+#include "PoleGrid.h"
+
+using namespace std;
+using namespace HMesh;
+using namespace CGLA;
+
+namespace Procedural{
+
+void PoleGrid::setCellSize( double cell_size ){
+    assert( cell_size > 0.0 );
+    vector< Entry > all;
+    all.reserve( no_points );
+    for( const auto& item : cells ){
+        all.insert( all.end(), item.second.begin(), item.second.end( ));
+    }
+    clear();
+    h = cell_size;
+    for( const Entry& e : all ){ insert( e.id, e.pos ); }
+}
+
+void PoleGrid::insert( VertexID v, const Vec3d& pos ){
+    int c[3] = { coord( pos[0] ), coord( pos[1] ), coord( pos[2] ) };
+    Entry e;
+    e.id    = v;
+    e.pos   = pos;
+    cells[key( c[0], c[1], c[2] )].push_back( e );
+    for( int i = 0; i < 3; ++i ){
+        lo[i] = ( no_points == 0 ) ? c[i] : std::min( lo[i], c[i] );
+        hi[i] = ( no_points == 0 ) ? c[i] : std::max( hi[i], c[i] );
+    }
+    ++no_points;
+}
+
+void PoleGrid::erase( VertexID v, const Vec3d& pos ){
+    auto it = cells.find( key( coord( pos[0] ), coord( pos[1] ), coord( pos[2] )));
+    assert( it != cells.end( ));
+    Cell& cell = it->second;
+    for( size_t i = 0; i < cell.size(); ++i ){
+        if( cell[i].id != v ){ continue; }
+        cell[i] = cell.back();
+        cell.pop_back();
+        --no_points;
+        break;
+    }
+    if( cell.empty( )){ cells.erase( it ); }
+}
+
+void PoleGrid::clear(){
+    cells.clear();
+    no_points = 0;
+    for( int i = 0; i < 3; ++i ){ lo[i] = 0; hi[i] = -1; }
+}
+
+int PoleGrid::maxShell( int x, int y, int z ) const{
+    int c[3] = { x, y, z };
+    int shell = 0;
+    for( int i = 0; i < 3; ++i ){
+        shell = std::max( shell, std::max( c[i] - lo[i], hi[i] - c[i] ));
+    }
+    return shell;
+}
+
+}
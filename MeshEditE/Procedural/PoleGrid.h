@@ -0,0 +1,195 @@
+//
+//  PoleGrid.h
+//  MeshEditE
+//
+
+#ifndef __MeshEditE__PoleGrid__
+#define __MeshEditE__PoleGrid__
+
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <cstdint>
+#include <cmath>
+
+#include <GEL/HMesh/Manifold.h>
+#include <GEL/CGLA/Vec3d.h>
+
+namespace Procedural{
+
+/// uniform hash grid over a set of points ( the free poles of the main structure ).
+/// insert and erase only touch one cell, so the grid is updated as poles are glued instead of
+/// being rebuilt. Queries visit the cells in shells of growing radius around the query point and
+/// stop as soon as no closer point can be found, with a cell size close to the spacing of the
+/// points their cost does not depend on how many points are stored.
+/// Queries are const and can run concurrently, insert and erase can not.
+class PoleGrid{
+public:
+    typedef std::pair< HMesh::VertexID, double > IDDist;
+
+    explicit PoleGrid( double cell_size = 1.0 ) : h( cell_size ) {}
+
+    inline size_t   size()      const { return no_points; }
+    inline bool     empty()     const { return no_points == 0; }
+    inline double   cellSize()  const { return h; }
+
+    // rehashes the points already in the grid
+    void    setCellSize( double cell_size );
+    void    insert( HMesh::VertexID v, const CGLA::Vec3d& pos );
+    // pos must be the position v was inserted with
+    void    erase( HMesh::VertexID v, const CGLA::Vec3d& pos );
+    void    clear();
+
+    /// the ( up to ) k points closest to p, within max_dist and accepted by the filter, sorted
+    /// by increasing distance. accept is called as accept( VertexID ) -> bool
+    template< typename Filter >
+    size_t  kNearest( const CGLA::Vec3d& p, size_t k, double max_dist, const Filter& accept,
+                      std::vector< IDDist >& result ) const;
+    /// all the points within radius from p accepted by the filter, in no particular order
+    template< typename Filter >
+    size_t  inSphere( const CGLA::Vec3d& p, double radius, const Filter& accept,
+                      std::vector< IDDist >& result ) const;
+
+    template< typename Filter >
+    bool    closest( const CGLA::Vec3d& p, double max_dist, const Filter& accept,
+                     HMesh::VertexID& found, double& dist ) const {
+        std::vector< IDDist > result;
+        if( kNearest( p, 1, max_dist, accept, result ) == 0 ){ return false; }
+        found   = result.front().first;
+        dist    = result.front().second;
+        return true;
+    }
+    inline bool closest( const CGLA::Vec3d& p, HMesh::VertexID& found, double& dist ) const {
+        return closest( p, HUGE_VAL, []( HMesh::VertexID ){ return true; }, found, dist );
+    }
+
+private:
+    struct Entry{
+        HMesh::VertexID id;
+        CGLA::Vec3d     pos;
+    };
+    typedef std::vector< Entry >    Cell;
+    typedef uint64_t                CellKey;
+
+    // cell coordinates are packed in 21 bits each
+    static const int                COORD_OFFSET = 1 << 20;
+
+    inline int      coord( double x ) const { return static_cast< int >( std::floor( x / h )); }
+    inline CellKey  key( int x, int y, int z ) const {
+        assert( std::abs( x ) < COORD_OFFSET && std::abs( y ) < COORD_OFFSET && std::abs( z ) < COORD_OFFSET );
+        return ( static_cast< CellKey >( x + COORD_OFFSET ) << 42 ) |
+               ( static_cast< CellKey >( y + COORD_OFFSET ) << 21 ) |
+                 static_cast< CellKey >( z + COORD_OFFSET );
+    }
+    inline const Cell* find( int x, int y, int z ) const {
+        auto it = cells.find( key( x, y, z ));
+        return ( it == cells.end( )) ? NULL : &it->second;
+    }
+
+    // largest shell that can contain a point
+    int     maxShell( int x, int y, int z ) const;
+
+    std::unordered_map< CellKey, Cell > cells;
+    double                              h;
+    size_t                              no_points   = 0;
+    int                                 lo[3]       = {  0,  0,  0 };   // bounds of the cells ever used
+    int                                 hi[3]       = { -1, -1, -1 };
+};
+
+
+template< typename Filter >
+size_t PoleGrid::kNearest( const CGLA::Vec3d& p, size_t k, double max_dist, const Filter& accept,
+                           std::vector< IDDist >& result ) const {
+    result.clear();
+    if( k == 0 || empty( )){ return 0; }
+
+    auto farther = []( const IDDist& l, const IDDist& r ){ return l.second < r.second; };
+    // result is kept as a max heap, the front is the farthest of the k best points found so far.
+    // no other storage is used, so a caller that reuses result does not allocate
+    auto consider = [&]( const Cell& cell ){
+        for( const Entry& e : cell ){
+            double d = ( e.pos - p ).length();
+            if( d > max_dist || ( result.size() == k && d >= result.front().second )){ continue; }
+            if( !accept( e.id )){ continue; }
+            if( result.size() == k ){
+                std::pop_heap( result.begin(), result.end(), farther );
+                result.back() = std::make_pair( e.id, d );
+            }
+            else{ result.push_back( std::make_pair( e.id, d )); }
+            std::push_heap( result.begin(), result.end(), farther );
+        }
+    };
+
+    const int cx = coord( p[0] ), cy = coord( p[1] ), cz = coord( p[2] );
+    int last_shell = maxShell( cx, cy, cz );
+    if( max_dist < HUGE_VAL ){
+        last_shell = std::min( last_shell, static_cast< int >( std::ceil( max_dist / h )) + 1 );
+    }
+
+    size_t visited = 0;
+    for( int r = 0; r <= last_shell; ++r ){
+        // every point in shell r is at least ( r - 1 ) * h away from p
+        if( result.size() == k && ( r - 1 ) * h > result.front().second ){ break; }
+        // the shells have become larger than the grid itself, a linear scan is cheaper
+        if( visited > cells.size( )){
+            result.clear();
+            for( const auto& item : cells ){ consider( item.second ); }
+            break;
+        }
+        for( int dx = -r; dx <= r; ++dx ){
+            for( int dy = -r; dy <= r; ++dy ){
+                bool on_shell = ( std::abs( dx ) == r || std::abs( dy ) == r );
+                // inside the shell only the two z faces are visited
+                for( int dz = -r; dz <= r; dz += ( on_shell || r == 0 ) ? 1 : 2 * r ){
+                    ++visited;
+                    const Cell* cell = find( cx + dx, cy + dy, cz + dz );
+                    if( cell != NULL ){ consider( *cell ); }
+                }
+            }
+        }
+    }
+
+    std::sort_heap( result.begin(), result.end(), farther );
+    return result.size();
+}
+
+
+template< typename Filter >
+size_t PoleGrid::inSphere( const CGLA::Vec3d& p, double radius, const Filter& accept,
+                           std::vector< IDDist >& result ) const {
+    result.clear();
+    if( empty( )){ return 0; }
+
+    auto consider = [&]( const Cell& cell ){
+        for( const Entry& e : cell ){
+            double d = ( e.pos - p ).length();
+            if( d <= radius && accept( e.id )){ result.push_back( std::make_pair( e.id, d )); }
+        }
+    };
+
+    int from[3], to[3];
+    for( int i = 0; i < 3; ++i ){
+        from[i] = std::max( lo[i], coord( p[i] - radius ));
+        to[i]   = std::min( hi[i], coord( p[i] + radius ));
+        if( from[i] > to[i] ){ return 0; }
+    }
+    double no_cells = static_cast< double >( to[0] - from[0] + 1 ) * ( to[1] - from[1] + 1 ) * ( to[2] - from[2] + 1 );
+    if( no_cells > cells.size( )){
+        for( const auto& item : cells ){ consider( item.second ); }
+        return result.size();
+    }
+    for( int x = from[0]; x <= to[0]; ++x ){
+        for( int y = from[1]; y <= to[1]; ++y ){
+            for( int z = from[2]; z <= to[2]; ++z ){
+                const Cell* cell = find( x, y, z );
+                if( cell != NULL ){ consider( *cell ); }
+            }
+        }
+    }
+    return result.size();
+}
+
+}
+
+#endif /* defined(__MeshEditE__PoleGrid__) */
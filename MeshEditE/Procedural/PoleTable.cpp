@@ -0,0 +1,94 @@
+//
+//  PoleTable.cpp
+//  MeshEditE
+//
+
+#include "PoleTable.h"
+#include "Test.h"
+
+using namespace std;
+using namespace HMesh;
+using namespace CGLA;
+
+namespace Procedural{
+
+void PoleTable::set( VertexID v, const PoleInfo& pi ){
+    int s = findSlot( v );
+    if( s < 0 ){
+        s = static_cast<int>( ids.size( ));
+        ids.push_back( v );
+        infos.push_back( pi );
+        positions.push_back( pi.geometry.pos );
+        normals.push_back( pi.geometry.normal );
+        valences.push_back( pi.geometry.valence );
+        bind( v, s );
+    }
+    infos[s] = pi;
+    mirror( s );
+}
+
+void PoleTable::erase( VertexID v ){
+    Slot s      = slot( v );
+    Slot last   = ids.size() - 1;
+    if( s != last ){
+        ids[s]          = ids[last];
+        infos[s]        = infos[last];
+        positions[s]    = positions[last];
+        normals[s]      = normals[last];
+        valences[s]     = valences[last];
+        slotOf[ids[s].get_index()] = static_cast<int>( s );
+    }
+    slotOf[v.get_index()] = -1;
+    ids.pop_back();
+    infos.pop_back();
+    positions.pop_back();
+    normals.pop_back();
+    valences.pop_back();
+}
+
+void PoleTable::clear(){
+    ids.clear();
+    infos.clear();
+    positions.clear();
+    normals.clear();
+    valences.clear();
+    slotOf.clear();
+}
+
+void PoleTable::reAlignIDs( const VertexIDTable& table ){
+    slotOf.clear();
+    for( Slot s = 0; s < ids.size(); ++s ){
+        ids[s] = remapped( table, ids[s] );
+        bind( ids[s], s );
+    }
+}
+
+void PoleTable::transform( const Mat4x4d& T ){
+    for( Slot s = 0; s < ids.size(); ++s ){
+        PoleInfo& pi = infos[s];
+        pi.geometry.pos          = T.mul_3D_point( pi.geometry.pos );
+        pi.geometry.normal       = mul_3D_dir( T, pi.geometry.normal );
+        pi.anisotropy.direction  = T.mul_3D_vector( pi.anisotropy.direction );
+        
+        assert( !( isnan( pi.geometry.pos[0] ) || isnan( pi.geometry.pos[1] ) || isnan( pi.geometry.pos[2] )));
+        assert( !( isnan( pi.geometry.normal[0] ) || isnan( pi.geometry.normal[1] ) || isnan( pi.geometry.normal[2] )));
+        assert( !pi.anisotropy.is_defined ||
+                !( isnan( pi.anisotropy.direction[0] ) || isnan( pi.anisotropy.direction[1] ) || isnan( pi.anisotropy.direction[2] )));
+        mirror( s );
+    }
+}
+
+void PoleTable::mirror( Slot s ){
+    const PoleInfo& pi = infos[s];
+    positions[s]    = pi.geometry.pos;
+    normals[s]      = pi.geometry.normal;
+    valences[s]     = pi.geometry.valence;
+}
+
+void PoleTable::bind( VertexID v, Slot s ){
+    size_t index = v.get_index();
+    if( index >= slotOf.size( )){ slotOf.resize( index + 1, -1 ); }
+    slotOf[index] = static_cast<int>( s );
+}
+
+}
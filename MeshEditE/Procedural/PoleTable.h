@@ -0,0 +1,112 @@
+//
+//  PoleTable.h
+//  MeshEditE
+//
+
+#ifndef __MeshEditE__PoleTable__
+#define __MeshEditE__PoleTable__
+
+#include <stdio.h>
+#include <vector>
+
+#include <GEL/HMesh/Manifold.h>
+#include <GEL/CGLA/Vec3d.h>
+#include <GEL/CGLA/Mat4x4d.h>
+
+namespace Procedural{
+
+typedef unsigned int Moduletype;
+
+/// old -> new vertex IDs as a dense table indexed by VertexID::get_index().
+/// vertices that are not remapped have InvalidVertexID
+typedef std::vector< HMesh::VertexID > VertexIDTable;
+
+inline HMesh::VertexID remapped( const VertexIDTable& table, HMesh::VertexID v ){
+    assert( v.get_index() < table.size() && table[v.get_index()] != HMesh::InvalidVertexID );
+    return table[v.get_index()];
+}
+
+struct PoleAnisotropyInfo{
+    CGLA::Vec3d     direction;
+    bool            is_defined   = false;
+    bool            is_bilateral = false ;
+};
+
+struct PoleGeometryInfo{
+    unsigned int    valence;
+    CGLA::Vec3d     pos;
+    CGLA::Vec3d     normal;
+};
+
+struct PoleInfo{
+    HMesh::VertexID     original_id;
+    PoleAnisotropyInfo  anisotropy;
+    PoleGeometryInfo    geometry;
+    Moduletype          moduleType  = 0;     // an identifier for the module's type
+
+    int                 age;                 // pole's starting age
+    bool                isFree      = true;
+    bool                isActive    = true;
+    bool                can_connect_to_self = true; /* can connect to an instance of the
+                                                     same pole on another module of the
+                                                     same exact type ( same file ) */
+};
+
+/// dense storage for the PoleInfo of a set of poles.
+/// each pole owns a slot in [0, size()), positions, normals and valences are also
+/// kept in contiguous arrays for the loops that only need the geometry ( matching, subsets ).
+/// VertexID -> slot is a plain array indexed by VertexID::get_index()
+class PoleTable{
+public:
+    typedef size_t Slot;
+
+    inline size_t           size()  const { return ids.size(); }
+    inline bool             empty() const { return ids.empty(); }
+    // same meaning of std::map::count
+    inline size_t           count( HMesh::VertexID v ) const { return ( findSlot( v ) >= 0 ) ? 1 : 0; }
+    inline Slot             slot( HMesh::VertexID v ) const {
+        int s = findSlot( v );
+        assert( s >= 0 );
+        return static_cast<Slot>( s );
+    }
+    inline const PoleInfo&  at( HMesh::VertexID v ) const { return infos[slot( v )]; }
+
+    // slot based access
+    inline HMesh::VertexID      id( Slot s )        const { return ids[s]; }
+    inline const PoleInfo&      info( Slot s )      const { return infos[s]; }
+    inline const CGLA::Vec3d&   pos( Slot s )       const { return positions[s]; }
+    inline const CGLA::Vec3d&   normal( Slot s )    const { return normals[s]; }
+    inline unsigned int         valence( Slot s )   const { return valences[s]; }
+
+    inline const std::vector< HMesh::VertexID >&   getIDs()        const { return ids; }
+    inline const std::vector< CGLA::Vec3d >&       getPositions()  const { return positions; }
+    inline const std::vector< CGLA::Vec3d >&       getNormals()    const { return normals; }
+
+    // inserts a new pole or replaces the info of an existing one
+    void    set( HMesh::VertexID v, const PoleInfo& pi );
+    // the last pole takes the slot of the erased one
+    void    erase( HMesh::VertexID v );
+    void    clear();
+    // one pass over the slots, the order of the poles does not change
+    void    reAlignIDs( const VertexIDTable& table );
+    void    transform( const CGLA::Mat4x4d& T );
+
+private:
+    inline int findSlot( HMesh::VertexID v ) const {
+        size_t index = v.get_index();
+        return ( index < slotOf.size( )) ? slotOf[index] : -1;
+    }
+    void    mirror( Slot s );
+    void    bind( HMesh::VertexID v, Slot s );
+
+    std::vector< HMesh::VertexID >  ids;
+    std::vector< PoleInfo >         infos;
+    std::vector< CGLA::Vec3d >      positions;
+    std::vector< CGLA::Vec3d >      normals;
+    std::vector< unsigned int >     valences;
+    std::vector< int >              slotOf;     // -1 for vertices that are not poles
+};
+
+}
+
+#endif /* defined(__MeshEditE__PoleTable__) */
@@ -8,13 +8,19 @@
 
 #include "StatefulEngine.h"
 
-#include <GEL/GLGraphics/ManifoldRenderer.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+#include <GEL/Util/Timer.h>
 
 #include "polarize.h"
 
-#include "MeshEditE/Procedural/Helpers/manifold_copy.h"
+#include <MeshEditE/HMeshParallelKit.h>
+
 #include "MeshEditE/Procedural/Helpers/geometric_properties.h"
 #include "MeshEditE/Procedural/Helpers/svd_alignment.h"
+#include "MeshEditE/Procedural/Helpers/min_cost_assignment.h"
 #include "MeshEditE/Procedural/Operations/structural_operations.h"
 #include "collision_detection.h"
 
@@ -39,19 +45,26 @@ using namespace Procedural::Operations::Structural;
 StatefulEngine::StatefulEngine()
 {
     this->m                 = NULL;
-    this->tree              = NULL;
     this->candidateModule   = NULL;
-    this->mainStructure     = NULL;
+    this->candidateIsPlaced = false;
+    this->hostIsBaked       = true;
     unsigned seed   = chrono::system_clock::now().time_since_epoch().count();
     randomizer.seed( seed );
-    treeIsValid     = false;
-
+    evaluationMode  = Evaluation_Deterministic;
+    noWorkers       = 0;
+    cullCollisions      = true;
+    collisionTolerance  = 0.1;
+    poseMatchBound      = 0;
+    poseSearchMode      = Search_Exhaustive;
+    noCoarseAngles      = 4;
+    noRefinedPoses      = 8;
+    noRefineIterations  = 4;
 }
 
 /********** UTILITIS **********/
 
-/// returns true if L < R
-bool IdDistPair_comparer( IdDistPair &l, IdDistPair &r ) { return ( l.second < r.second ); }
+// absolute tolerance on the difference of the pole distances used when pruning the matches
+static const EdgeCost SUBSET_TRESHOLD = make_pair( 0.5, 0.5 );
 
 
 void StatefulEngine::buildRandomRotation( CGLA::Mat4x4d &t ){
@@ -68,209 +81,112 @@ void StatefulEngine::buildRandomRotation( CGLA::Mat4x4d &t ){
 
 
 
-void StatefulEngine::buildMainStructureKdTree(){
-    assert( this->m != NULL );
-    assert( this->tree == NULL );
-    
-    this->tree = new kD_Tree();
-    ModuleAlignment::build_manifold_kdtree( (*this->m), mainStructure->getFreePoleSet(), *this->tree );
-    for( auto& vid : mainStructure->getFreePoleSet( )){
-        assert( is_pole( *m, vid ));
-    }
-    treeIsValid = true;
-}
-
-
 /********** MATCHING **********/
 
-void StatefulEngine::matchModuleToHost( Module &candidate, VertexMatchMap& M_pole_to_H_vertex ){
-
-    typedef vector<IdDistPair >                                Near_Pole_Vector;
-    typedef map< VertexID, Near_Pole_Vector >                  Candidate_Neighbors;
+// each module pole can be matched to one of its K_CANDIDATES nearest free poles that have the same
+// valence, an opposite normal and pass poleCanMatch. The assignment maximizes the number of matched
+// poles first and minimizes the sum of the distances then. The matches are written into M_to_H sorted
+// by module pole. The working set is thread local, since the evaluation runs on the threads of the
+// persistent pool it keeps its capacity from one call ( and one step ) to the next and, with a reused
+// M_to_H, the matching does not allocate once it is warm
+void StatefulEngine::matchModuleToHost( const TransformedModuleView &candidate, vector< Match >& M_to_H ){
+    static const size_t K_CANDIDATES = 4;
     
-    VertexSet           assigned_candidates, unassigned_poles;
-    Candidate_Neighbors candidateNeighbors;
-    // from module's pole to host's candidate
-    VertexMatchMap      internal_match;
+    struct CandidateEdge{
+        size_t  row, col;
+        double  dist;
+    };
+    thread_local AssignmentSolver               solver;
+    thread_local vector< PoleGrid::IDDist >     nearest;
+    thread_local vector< VertexID >             columns;    // distinct host poles
+    thread_local vector< CandidateEdge >        edges;
+    thread_local vector< int >                  row_to_col;
+    columns.clear();
+    edges.clear();
+    M_to_H.clear();
     
-    // find the nearest host candidate for each module's pole
-    // and, for each candidate matched, store its matched pole and distance
-    for( const auto& id_and_info : candidate.getPoleInfoMap())
+    const PoleTable& M_poles    = candidate.getPoleTable();
+    const PoleTable& H_poles    = mainStructure->getPoleTable();
+    const PoleGrid&  grid       = mainStructure->getPoleGrid();
+    double           dist_sum   = 0.0;
+    for( PoleTable::Slot slot = 0; slot < M_poles.size(); ++slot )
     {
-        double      distance    = numeric_limits<double>::max();
-        Vec3d       foundPos;
-        VertexID    foundID = InvalidVertexID, second_choiceID = InvalidVertexID;
-        bool        have_found  = (*tree).closest_point( id_and_info.second.geometry.pos , distance, foundPos, foundID );
+        unsigned int    valence     = M_poles.valence( slot );
+        Vec3d           pole_pos    = candidate.slotPos( slot );
+        Vec3d           pole_normal = candidate.slotNormal( slot );
         
-        assert( have_found );
-        assert( foundID != InvalidVertexID );
-        assert( mainStructure->getFreePoleSet().count(foundID) > 0 );
+        // the full PoleInfo is only read for the host poles that pass the geometric tests
+        auto can_match = [&]( VertexID H_pole ){
+            PoleTable::Slot h = H_poles.slot( H_pole );
+            return H_poles.valence( h ) == valence
+                && opposite_directions( pole_normal, H_poles.normal( h ))
+                && Module::poleCanMatch( H_poles.info( h ), M_poles.info( slot ));
+        };
+        grid.kNearest( pole_pos, K_CANDIDATES, HUGE_VAL, can_match, nearest );
         
-        if( have_found ){
-#ifdef TRACE
-            cout << " HAVE FOUND "<< endl;
-#endif
-//            Vec3d n_candidate = vertex_normal( *m, foundID );
-//            n_candidate.normalize();
-//            size_t valence = Geometry::valence( *m, foundID );
-            const PoleInfo& host_pole_info  = mainStructure->getPoleInfo( foundID );
-            const Vec3d&    n_candidate     = host_pole_info.geometry.normal;
-            size_t          valence         = host_pole_info.geometry.valence;
-
-
-            
-            // add only if match is valid
+        for( const PoleGrid::IDDist& item : nearest ){
+            size_t col = find( columns.begin(), columns.end(), item.first ) - columns.begin();
+            if( col == columns.size( )){ columns.push_back( item.first ); }
+            CandidateEdge e;
+            e.row   = slot;
+            e.col   = col;
+            e.dist  = item.second;
+            edges.push_back( e );
+            dist_sum += item.second;
 #ifdef TRACE
-            cout << "M : " << id_and_info.first << ")" << id_and_info.second.geometry.pos << "  #  " << id_and_info.second.geometry.normal << endl;
-            cout << "H : " << foundID << ")" << foundPos << "  #  " << n_candidate << endl << endl;
-            bool opposite_debug = opposite_directions( id_and_info.second.geometry.normal, n_candidate );
-            cout << " opposite? " <<opposite_debug << "valence H : " << valence << " # M : " << id_and_info.second.geometry.valence<<endl;
+            cout << "M : " << M_poles.id( slot ) << ")" << pole_pos << "  #  " << pole_normal << endl;
+            cout << "H : " << item.first << ")" << mainStructure->getPoleInfo( item.first ).geometry.pos << "  #  "
+                 << mainStructure->getPoleInfo( item.first ).geometry.normal << " at " << item.second << endl << endl;
 #endif
-
-            if( Module::poleCanMatch(host_pole_info, id_and_info.second)){
-                if( opposite_directions( id_and_info.second.geometry.normal, n_candidate )){
-                    
-                    // instantiate vector if putting the first value
-                    if( candidateNeighbors.count( foundID ) == 0 ){
-                        candidateNeighbors[foundID] = Near_Pole_Vector();
-                    }
-                    
-                    candidateNeighbors[foundID].push_back( make_pair( id_and_info.first, distance ));
-                    assigned_candidates.insert( foundID );
-                    // maps from module to main structure
-                    internal_match[id_and_info.first] = foundID;
-                }
-            }
-        }
-    }
-    
-    // here I should process all the candidateNeighbors for which the number of matched
-    // poles > 1 and try to assign them to not assigned candidates
-    for( auto& item : candidateNeighbors ){
-        assert( item.second.size() > 0 );
-        if( item.second.size() == 1 ) {
-            M_pole_to_H_vertex[item.second.front().first] = item.first;
-        }
-        else{
-            // get the nearest matched pole
-            IdDistPair& nearest = item.second.front();
-            for( IdDistPair& id_dist : item.second ){
-                if( IdDistPair_comparer( id_dist, nearest )){
-                    nearest = id_dist;
-                }
-            }
-            // save the nearest match into the output map
-            M_pole_to_H_vertex[nearest.first] = item.first;
-            assigned_candidates.insert( item.first );
-//          put all the other poles that have found a neighbor into the unassigned set
-            for( IdDistPair& id_dist : item.second ){
-                if( id_dist.first != nearest.first ){ unassigned_poles.insert( id_dist.first ); }
-            }
-        }
-    }
-    
-    // for each unassigned pole try to find a secondary nearest match
-    for( VertexID unassigned : unassigned_poles ){
-                
-        assert( candidate.getPoleInfoMap().count( unassigned ) > 0 );
-        const PoleGeometryInfo& pgi = candidate.getPoleInfo( unassigned ).geometry;
-
-        VertexID second_cloesest = InvalidVertexID;
-        
-        if( findSecondClosest( unassigned, pgi, internal_match[unassigned], second_cloesest, assigned_candidates )){
-            assert( mainStructure->getFreePoleSet().count(second_cloesest) > 0 );
-            M_pole_to_H_vertex[unassigned] = second_cloesest;
         }
     }
+    if( edges.empty( )){ return; }
     
-    // sanity check
-    map<VertexID, int> _candidates, _poles;
-    for( const auto& item : M_pole_to_H_vertex ){
-        _poles[item.first]          = 0;
-        _candidates[item.second]    = 0;
+    // one "unmatched" column per module pole. Leaving a pole unmatched costs more than all the
+    // candidate edges together and a forbidden edge costs more than leaving every pole unmatched
+    size_t no_rows      = M_poles.size(),
+           no_cols      = columns.size() + no_rows;
+    double unmatched    = dist_sum + 1.0,
+           forbidden    = ( no_rows + 1 ) * unmatched;
+    solver.reset( no_rows, no_cols, forbidden );
+    for( size_t r = 0; r < no_rows; ++r ){
+        for( size_t c = columns.size(); c < no_cols; ++c ){ solver.cost( r, c ) = unmatched; }
     }
+    for( const CandidateEdge& e : edges ){ solver.cost( e.row, e.col ) = e.dist; }
+    solver.solve( row_to_col );
     
-    for( auto& item : M_pole_to_H_vertex ){
-        _poles[item.first] = _poles[item.first] + 1;
-        _candidates[item.second] = _candidates[item.second] + 1;
-        // each pole MUST be assigned to only one candidate and each candidate to only one pole
-        assert( _poles.count( item.first ) <= 1);
-        assert( _candidates.count( item.second ) <= 1);
-//        assert( is_pole( *(candidateModule->m), item.first ));
-        assert( candidateModule->isPole( item.first ));
-        assert( is_pole( *m, item.second ));
+    for( size_t r = 0; r < no_rows; ++r ){
+        size_t c = static_cast< size_t >( row_to_col[r] );
+        if( c >= columns.size( )){ continue; }
+        assert( candidate.isPole( M_poles.id( r )));
+        assert( mainStructure->isFreePole( columns[c] ));
+        M_to_H.push_back( make_pair( M_poles.id( r ), columns[c] ));
 #ifdef TRACE
-        cout << item.first << " # " << item.second << endl;
+        cout << M_poles.id( r ) << " # " << columns[c] << endl;
 #endif
     }
-    
-#ifdef TRACE
-    cout << "candidates size " <<  _candidates.size() << endl;
-#endif
+    sort( M_to_H.begin(), M_to_H.end(), []( const Match& l, const Match& r ){ return l.first < r.first; });
 }
 
 
-bool StatefulEngine::findSecondClosest( const VertexID &pole, const PoleGeometryInfo &pgi, const VertexID &closest, VertexID &second_closest, VertexSet &assigned ){
-    assert( assigned.count( closest ) > 0 );
-    // consider closest
-    Vec3d       closest_pos = m->pos( closest );
-    // find the mean distance from 1-neighbors
-    double      mean_dist   = numeric_limits<double>::max();
-    size_t      valence     = 0;
-    for( Walker w = m->walker( closest ); !w.full_circle(); w = w.circulate_vertex_ccw())
-    {
-#warning consider using squared length
-        double dist = ( closest_pos - m->pos( w.vertex( ))).length( );
-        mean_dist += dist;
-        ++valence;
-    }
-    // take that distance as radius and use it with tree.in_sphere with center in closest
-    double              query_radius = mean_dist / (float)valence;
-    vector<VertexID>    in_sphere_ID;
-    vector<Vec3d>       in_sphere_points;
-    IDsDistsVector      ids_and_dists;
-    
-    (*tree).in_sphere( closest_pos, query_radius, in_sphere_points, in_sphere_ID );
-    // take the nearest point
-    assert( in_sphere_ID.size() == in_sphere_points.size());
-    
-    for( int i = 0; i < in_sphere_points.size(); ++i){
-        ids_and_dists.push_back( make_pair( in_sphere_ID[i], (closest_pos - in_sphere_points[i] ).length( )));
-    }
-    
-    // sort in ascending order accordingly to the distance
-    std::sort( ids_and_dists.begin(), ids_and_dists.end(), IdDistPair_comparer );
-    IDsDistsVector::iterator it      = ids_and_dists.begin();
-    bool                    done    = false;
-    while ( !done && it != ids_and_dists.end( ) )
-    {        
-        // check if normals are compatible
-        Vec3d n_candidate = vertex_normal( *m, it->first );
-        n_candidate.normalize();
+/********** APPLICATION OF TRANSFORMATIONS **********/
 
-        done    = (( assigned.count( it->first ) == 0 )
-                  && opposite_directions( pgi.normal, n_candidate ))
-                  && Geometry::valence( *m, it->first ) == pgi.valence;
-        if( !done ) { ++it; }
-    }
-    if( done ){
-        second_closest = it->first;
-        assigned.insert( it->first );
+// the toolbox module is never modified : the first time the candidate gets transformed or realigned
+// it is replaced by a copy, which will be owned by the main structure once glued.
+// the copy shares the toolbox mesh, the transformations are accumulated into its placement
+Procedural::Module& StatefulEngine::placedCandidate(){
+    assert( candidateModule != NULL );
+    if( !candidateIsPlaced ){
+        candidateModule     = &candidateModule->getTransformedModule( identity_Mat4x4d( ));
+        candidateIsPlaced   = true;
     }
-    return done;
+    return *candidateModule;
 }
 
 
-/********** APPLICATION OF TRANSFORMATIONS **********/
-
 void StatefulEngine::applyRandomTransform(){
 //    cout << "transforming using : " << endl << best_match.getMatchInfo().random_transform << endl;
-    Module &tm = candidateModule->getTransformedModule( best_match.getMatchInfo().random_transform);
-    candidateModule = &tm;
-    
-    for( VertexID v : M_vertices ){
-        m->pos( v) = best_match.getMatchInfo().random_transform.mul_3D_point( m->pos( v ));
-    }
+    placedCandidate().transform( best_match.getMatchInfo().random_transform );
     
     assert( candidateModule->poleList.size() > 0 );
 }
@@ -285,7 +201,7 @@ void StatefulEngine::applyOptimalAlignment(){
         host_v.push_back( match.second );
         
         module_pos.push_back( candidateModule->getPoleInfo( match.first ).geometry.pos );
-        host_pos.push_back( m->pos( match.second ));
+        host_pos.push_back( mainStructure->getPoleInfo( match.second ).geometry.pos );
     }
 
     svd_rigid_motion( module_pos, host_pos, R, T );
@@ -296,11 +212,7 @@ void StatefulEngine::applyOptimalAlignment(){
     cout << "Best Match Optimal (SVD) Alignment " << endl << t << endl;
 #endif
 
-    Module &tm = candidateModule->getTransformedModule( t );
-    candidateModule = &tm;
-    for( VertexID v : M_vertices ){
-        m->pos( v) = t.mul_3D_point( m->pos( v ));
-    }
+    placedCandidate().transform( t );
     assert( candidateModule->poleList.size() > 0 );
 }
 
@@ -312,7 +224,7 @@ void StatefulEngine::alignModuleNormalsToHost(){
     {
         centroid += candidateModule->getPoleInfo(match.first).geometry.pos;
         Vec3d mn = candidateModule->getPoleInfo(match.first).geometry.normal;
-        Vec3d hn = vertex_normal( *m, match.second );
+        Vec3d hn = mainStructure->getPoleInfo( match.second ).geometry.normal;
         
         assert( !( isnan( mn[0] ) || isnan( mn[1] ) || isnan( mn[2] )));
         assert( !( isnan( hn[0] ) || isnan( hn[1] ) || isnan( hn[2] )));
@@ -348,11 +260,7 @@ void StatefulEngine::alignModuleNormalsToHost(){
     cout << "Best Match Normal Alignment " << endl << t << endl;
 #endif
     
-    Module& tm = candidateModule->getTransformedModule( t );
-    candidateModule = &tm;
-    for( VertexID v : M_vertices ){
-        m->pos( v) = t.mul_3D_point( m->pos( v ));
-    }
+    placedCandidate().transform( t );
 
     assert( candidateModule->poleList.size() > 0 );
 }
@@ -371,32 +279,27 @@ void StatefulEngine::alignUsingBestMatch( ){
 
 
 
+// only the main structure is updated, the host mesh is rebuilt by bake
 void StatefulEngine::glueCurrent(){
-    // add manifold module to host
-    set<VertexID> _h;
-    IDRemap remap;
-    VertexIDRemap host_remap, module_remap;
-    vector<Match> remapped_matches;
-    add_manifold(*m, *candidateModule->m, host_remap, module_remap, M_vertices );
-    mainStructure->reAlignIDs( host_remap );
-    candidateModule->reAlignIDs( module_remap );
-    // remap matches ids
-    for( Match& match : best_match.getMatchInfo().matches){
-
-#ifdef TRACE
-        cout << "old match : ( " << match.first << ", " << match.second << " )" << endl;
-#endif
+    if( queueCurrent( )){ glueQueued(); }
+}
 
-        assert( module_remap[match.first]  != InvalidVertexID );
-        assert( host_remap[match.second]   != InvalidVertexID );
 
-#ifdef TRACE
-        cout << "new match : ( " << module_remap[match.first] << ", " << host_remap[match.second] << " )" << endl;
-#endif
-        remapped_matches.push_back( make_pair( module_remap[match.first], host_remap[match.second]) );
-    }
+bool StatefulEngine::queueCurrent(){
+    Util::Timer timer;
+    timer.start();
     
-    best_match.getMatchInfo().matches = std::move( remapped_matches );
+    for( const Placement& p : glueQueue ){
+        for( const Match& queued : p.matches ){
+            for( const Match& match : best_match.getMatchInfo().matches ){
+                if( queued.second == match.second ){
+                    cout << "host pole " << match.second << " is already used by a queued module" << endl;
+                    consolidate();
+                    return false;
+                }
+            }
+        }
+    }
 
 #ifdef TRACE
     for( Match& match : best_match.getMatchInfo().matches){
@@ -407,67 +310,56 @@ void StatefulEngine::glueCurrent(){
     applyRandomTransform();
     applyOptimalAlignment();
     alignModuleNormalsToHost();
-
-    
-    // glue_matches
-    Helpers::ModuleAlignment::glue_matches( *m, best_match.getMatchInfo().matches );
-    // mainStructure->glueModule
-    mainStructure->glueModule( *candidateModule, best_match.getMatchInfo().matches );
-    
-    IDRemap glue_remap;
     
-    m->cleanup( glue_remap );
-    mainStructure->reAlignIDs( glue_remap.vmap );
-
-#ifdef TRACE
-    for( VertexID v : (*candidateModule).poleList ){
-        if( mainStructure->getFreePoleSet().count(v) > 0 ){
-            cout << "on module" << endl;
-            cout << candidateModule->getPoleInfo(v).geometry.pos << endl;
-            cout << candidateModule->getPoleInfo(v).geometry.normal << endl;
-            cout << "on main structure" << endl;
-            cout << m->pos(v) << endl;
-            Vec3d normal = vertex_normal(*m, v);
-            normal.normalize();
-            cout << normal << endl;
-            cout << endl<<endl;
-            
+    // the search only tested the candidate against the main structure, the queued modules are not
+    // part of it yet. Both skeletons are already in place, so they are compared as they are
+    if( cullCollisions ){
+        for( const Placement& p : glueQueue ){
+            if( collide( p.module->getSkeleton(), candidateModule->getSkeleton(), identity_Mat4x4d(), collisionTolerance )){
+                cout << "the aligned module collides with a queued module" << endl;
+                Module *rejected = candidateModule;
+                consolidate();
+                Module::deleteKeepingMesh( rejected );
+                return false;
+            }
         }
     }
-#endif
+    
+    Placement p;
+    p.module    = &placedCandidate();
+    p.matches   = best_match.getMatchInfo().matches;
+    glueQueue.push_back( p );
+    
+    timings.glue += timer.get_secs();
     consolidate();
+    return true;
+}
+
+
+// the whole queue goes into the main structure at once, the host mesh is baked later, once
+void StatefulEngine::glueQueued(){
+    if( glueQueue.empty( )){ return; }
+    
+    Util::Timer timer;
+    timer.start();
+    
+    mainStructure->glueModules( glueQueue );
+    hostIsBaked = false;
+    
+    timings.glue        += timer.get_secs();
+    timings.no_glueings += glueQueue.size();
+    for( const Placement& p : glueQueue ){ gluedModules.push_back( p.module ); }
+    glueQueue.clear();
 }
 
 
 void StatefulEngine::actualGlueing(){
     if( best_match.IsValid( )){
-        
-        // add manifold module to host
-        set<VertexID> _h;
-        IDRemap remap;
-        VertexIDRemap host_remap, module_remap;
-        vector<Match> remapped_matches;
-        add_manifold(*m, *candidateModule->m, host_remap, module_remap, M_vertices );
-        mainStructure->reAlignIDs( host_remap );
-        candidateModule->reAlignIDs( module_remap );
-        // remap matches ids
-        for( Match& match : best_match.getMatchInfo().matches){
-            remapped_matches.push_back( make_pair( module_remap[match.first], host_remap[match.second]) );
-            
-#ifdef TRACE
-            cout << "old match : ( " << match.first << ", " << match.second << " )" << endl;
-            cout << "new match : ( " << module_remap[match.first] << ", " << host_remap[match.second] << " )" << endl;
-#endif
-        }
-        // glue_matches
-        Helpers::ModuleAlignment::glue_matches( *m, remapped_matches );
-        // mainStructure->glueModule
-        mainStructure->glueModule( *candidateModule, remapped_matches );
-        
-        IDRemap glue_remap;
-        
-        m->cleanup( glue_remap );
-        mainStructure->reAlignIDs( glue_remap.vmap );
+        Placement p;
+        p.module    = &placedCandidate();
+        p.matches   = best_match.getMatchInfo().matches;
+        glueQueue.push_back( p );
+        glueQueued();
         
         consolidate();
     }
@@ -483,34 +375,65 @@ StatefulEngine& StatefulEngine::getCurrentEngine(){
 }
 
 
+// the host mesh becomes the output of bake, the starting module keeps its own copy of it
 void StatefulEngine::setHost( Manifold &host ){
+    reset();
     this->m = &host;
-    this->mainStructure = new MainStructure();
+    mainStructure.reset( new MainStructure( ));
+    hostCopy.reset( new Manifold( host ));
     
-    Module *starter = new Module( *m, 0 );
+    Module *starter = new Module( *hostCopy, 0 );
     std::vector<Procedural::Match> matches;
     mainStructure->glueModule( *starter, matches);
+    gluedModules.push_back( starter );
+}
+
+
+void StatefulEngine::reset(){
+    // the queued copies and a placed candidate were never glued, nobody else owns them
+    for( Placement& p : glueQueue ){ Module::deleteKeepingMesh( p.module ); }
+    glueQueue.clear();
+    if( candidateIsPlaced ){ Module::deleteKeepingMesh( candidateModule ); }
+    candidateModule     = NULL;
+    candidateIsPlaced   = false;
+    transformedModules.clear();
+    
+    mainStructure.reset();
+    for( Module *module : gluedModules ){ Module::deleteKeepingMesh( module ); }
+    gluedModules.clear();
+    hostCopy.reset();
+    m           = NULL;
+    hostIsBaked = true;
+}
+
+
+void StatefulEngine::bake(){
+    assert( this->m != NULL );
+    if( hostIsBaked ){ return; }
+    
+    Util::Timer timer;
+    timer.start();
+    mainStructure->bake( *m );
+    hostIsBaked = true;
+    timings.bake += timer.get_secs();
 }
 
 
 void StatefulEngine::setModule(Procedural::Module &module){
     assert( module.m != NULL );
-    this->candidateModule = &module;
-    buildMainStructureKdTree();
+    this->candidateModule   = &module;
+    this->candidateIsPlaced = false;
 }
 
 
 void StatefulEngine::consolidate(){
     assert( this->m != NULL );
-    assert( this->candidateModule->getPoleInfoMap().size() > 0 );
+    assert( this->candidateModule->getPoleTable().size() > 0 );
     // in this way you lose any reference to which vertices are from host and module
 
-    candidateModule = NULL;
+    candidateModule     = NULL;
+    candidateIsPlaced   = false;
     transformedModules.clear();
-    
-    M_vertices.clear();
-    treeIsValid = false;
-    tree = NULL;
 }
 
 
@@ -547,26 +470,31 @@ bool lessThan( double lhs, double rhs, int no_decimals, bool acceptEqual = false
     
 }
 
+// cost of a proposed match as seen by chooseBestFitting, the more poles are matched the lower it is.
+// single matches get a little penalty since their cost is 0
+static double fitting_cost( const match_info& mi, const ExtendedCost& e ){
+    static const double d_penalty = 0.0001;
+    size_t match_valency = mi.matches.size();
+    if( match_valency == 1 ){ return d_penalty; }
+    double divider = static_cast<double>( match_valency );
+    return ( e.first + e.second.first + e.second.second ) / ( divider * divider );
+}
+
 // this should maximize the number of matches while minimizing the total cost
-// should add a little penalty to the single matches since their cost is 0
 // can I minimize that in a least square sense?
 size_t StatefulEngine::chooseBestFitting( const vector< match_info > proposed_matches, const vector< ExtendedCost > extendedCosts ) const{
     assert( proposed_matches.size() > 0 );
     size_t selected = 0;
     double best_sum_cost  = numeric_limits<double>::max();
-    double d_penalty      = 0.0001;
     double current_cost   = 0.0;
     
     for( int i = 0; i < proposed_matches.size(); ++i )
     {
         ExtendedCost e = extendedCosts[i];
         size_t match_valency = proposed_matches[i].matches.size();
-        if( match_valency == 1 ){
-            current_cost = d_penalty;
-        }else{
+        current_cost = fitting_cost( proposed_matches[i], e );
+        if( match_valency > 1 ){
             double divider = static_cast<double>( match_valency );
-            double squared_divider = divider * divider;            
-            current_cost = ( e.first +  e.second.first+ e.second.second ) / squared_divider  ;
             
             cout << i << " # " << match_valency << " # " << divider << endl;
             
@@ -593,94 +521,350 @@ size_t StatefulEngine::chooseBestFitting( const vector< match_info > proposed_ma
 }
 
 
-bool StatefulEngine::testMultipleTransformations(){
-        assert( this->m != NULL );
-    
-    vector< matchesAndCost >    matches_vector;
-    vector< match_info >        proposed_matches;
-    vector< ExtendedCost >      extendedCosts;
-    vector< Mat4x4d >           Ts;
-    vector< pair< size_t, ExtendedCost >>   stats;
-    
-    for( size_t d = 0; d < candidateModule->poleList.size(); ++d){ stats.push_back( make_pair( 0, make_pair( 0.0, make_pair( 0.0, 0.0 ))));}
+void StatefulEngine::evaluateTransformation( const TransformedModuleView &transformed, TransformEvaluation &result ){
     
-    buildTransformationList( Ts );
-//    return;
+    thread_local vector<Match>  current_matches;
+    vector<Match>               best_matches;
+    const Mat4x4d&  T = transformed.getTransform();
     
-    assert( candidateModule->getPoleInfoMap().size() > 0 );
+    result.isValid          = false;
+    result.no_raw_matches   = 0;
     
-    for( int i = 0; i < Ts.size(); ++i ){
-
-        VertexMatchMap  M_to_H;
-        vector<Match>   current_matches, best_matches;
-        match_info      mi;
-        
-        assert( !isnan( Ts[i][1][1] )); // Need to discover why putting this assert prevents to assign NaN to mi.random_transform
-        
-        mi.random_transform = Ts[i];
-        assert( !isnan( mi.random_transform[1][1] ));
+    assert( !isnan( T[1][1] ));
+    result.mi.random_transform = T;
+    assert( !isnan( result.mi.random_transform[1][1] ));
 
 #ifdef TRACE
-        cout << " Ts[i] " << Ts[i] << endl;
+    cout << " Ts[i] " << T << endl;
+    cout << "poles with normals " << endl;
+    for( VertexID p : transformed.getPoleList() )
+    {
+        cout << p << ")" << transformed.polePos( p ) << "  #  " << transformed.poleNormal( p ) << endl;
+    }
 #endif
-
-        // can be removed when solved
-
+    
+    Util::Timer timer;
+    timer.start();
+    matchModuleToHost( transformed, current_matches );
+    result.matchingTime = timer.get_secs();
+    
+    result.no_raw_matches = current_matches.size();
+    if( current_matches.empty( )) { return; }
+    
+    double distance_sum = 0.0;
+    
 #ifdef TRACE
-        cout << "poles with normals " << endl;
-        for( auto& item : transformedModules[i].getPoleInfoMap() )
-        {
-            cout << item.first << ")" << item.second.geometry.pos << "  #  " << item.second.geometry.normal << endl;
-        }
+    for( const Match& match : current_matches )
+    {
+        cout << match.first << ", " << match.second << endl;
+    }
 #endif
+    
+    std::vector< SubsetResult > results;
+    
+    double t_subsets = timer.get_secs();
+    get_subsets( *mainStructure, transformed, current_matches, results, SUBSET_TRESHOLD );
+    result.subsetsTime = timer.get_secs() - t_subsets;
+    
+    if( results.size() == 0 ){ return; }
+    
+    // LEGACY
+    assert( results.size() == 1 || results.front().matches.size() > results.back().matches.size( ));
+    
+    best_matches = std::move( results.front().matches );
+    EdgeCost c   = results.front().cost;
+    
+    for( auto& match : best_matches ){
         
-        matchModuleToHost( transformedModules[i], M_to_H );
-        
-        if( M_to_H.size() <= 0 ) { continue; }
-        
-        stats[M_to_H.size() - 1].first++;
-        
-        double distance_sum = 0.0;
-        
-        for( auto& pole_and_vertex : M_to_H )
-        {
+        double squared_dist = 0.0;
+        Vec3d d = transformed.polePos( match.first ) - mainStructure->getPoleInfo( match.second ).geometry.pos;
+        squared_dist = fabs( d[0] + d[1] + d[2] );
+        squared_dist /= 10E5;
+        distance_sum += squared_dist;
+    }
+    
+    result.mi.cost      = c;
+    result.extendedCost = make_pair( distance_sum, c );
 #ifdef TRACE
-            cout << pole_and_vertex.first << ", " << pole_and_vertex.second << endl;
+    cout << "configuration has cost : "
+    << result.mi.cost.first << ", " << result.mi.cost.second << ", " << distance_sum << endl;
 #endif
-            current_matches.push_back( make_pair( pole_and_vertex.first, pole_and_vertex.second ));
+    result.mi.matches   = std::move( best_matches );
+    result.isValid      = true;
+}
+
+
+// the workers are run on the persistent thread pool, on the calling thread when there is only one
+static void run_workers( size_t no_workers, const function< void( size_t ) >& worker ){
+    if( no_workers <= 1 ){
+        worker( 0 );
+        return;
+    }
+    ThreadPool::get().run( no_workers, 1, [&worker]( size_t b, size_t e ){
+        for( size_t t = b; t < e; ++t ){ worker( t ); }
+    });
+}
+
+
+size_t StatefulEngine::noEvaluationThreads( size_t no_transforms ) const{
+    if( evaluationMode == Evaluation_Serial ){ return 1; }
+    size_t no_threads = ThreadPool::get().no_threads();
+    if( noWorkers > 0 ){ no_threads = std::min( no_threads, noWorkers ); }
+    return std::max<size_t>( 1, std::min( no_threads, no_transforms ));
+}
+
+
+void StatefulEngine::evaluateTransformations( const vector< Mat4x4d > &Ts, vector< TransformEvaluation > &results ){
+    assert( Ts.size() == transformedModules.size( ));
+    evaluateTransformations( 0, Ts.size(), results );
+}
+
+
+// the workers only read the main structure and its pole grid,
+// each of them writes into its own transformed module and result slot
+void StatefulEngine::evaluateTransformations( size_t begin, size_t end, vector< TransformEvaluation > &results ){
+    assert( begin <= end && end <= transformedModules.size( ));
+    
+    size_t no_transforms = end - begin;
+    size_t no_threads    = noEvaluationThreads( no_transforms );
+    
+    results.clear();
+    results.resize( no_transforms );
+    
+    auto evaluate = [this, &results, begin]( size_t i ){
+        evaluateTransformation( transformedModules[begin + i], results[i] );
+        results[i].index = begin + i;
+    };
+    
+    if( evaluationMode == Evaluation_Parallel ){
+        // dynamic scheduling, the workers pull the next transformation
+        atomic<size_t> next( 0 );
+        run_workers( no_threads, [&]( size_t ){
+            for( size_t i = next++; i < no_transforms; i = next++ ){ evaluate( i ); }
+        });
+        return;
+    }
+    // static partition, one contiguous chunk per worker
+    run_workers( no_threads, [&]( size_t t ){
+        size_t from = ( t * no_transforms ) / no_threads;
+        size_t to   = (( t + 1 ) * no_transforms ) / no_threads;
+        for( size_t i = from; i < to; ++i ){ evaluate( i ); }
+    });
+}
+
+
+bool StatefulEngine::isGoodEnough( const TransformEvaluation &e ) const{
+    return searchBudget.goodEnoughCost >= 0.0
+        && e.isValid
+        && e.mi.matches.size() >= poseMatchBound
+        && fitting_cost( e.mi, e.extendedCost ) <= searchBudget.goodEnoughCost;
+}
+
+
+// the list is evaluated in a single pass : the workers pull the transformations in order and check the
+// budget before each of them. A good enough pose stops the pull of the poses after it, the ones before it
+// were pulled earlier and are all evaluated, so with an evaluation or cost budget the outcome does not
+// depend on the scheduling. The first pose is always evaluated so that a step can not end empty handed
+// only because the list took too long to build
+void StatefulEngine::evaluateWithinBudget( vector< TransformEvaluation > &results, Util::Timer &started ){
+    results.clear();
+    
+    size_t no_transforms = transformedModules.size();
+    if( searchBudget.maxEvaluations > 0 ){
+        no_transforms = std::min( no_transforms, searchBudget.maxEvaluations );
+    }
+    size_t no_threads = noEvaluationThreads( no_transforms );
+    
+    bool timed = searchBudget.maxSeconds > 0.0;
+    chrono::steady_clock::time_point deadline = chrono::steady_clock::now() +
+        chrono::duration_cast< chrono::steady_clock::duration >(
+            chrono::duration< double >( std::max( 0.0, searchBudget.maxSeconds - started.get_secs( ))));
+    
+    vector< TransformEvaluation >   slots( no_transforms );
+    vector< char >                  evaluated( no_transforms, 0 );
+    atomic< size_t >                next( 0 ), first_good( no_transforms );
+    
+    run_workers( no_threads, [&]( size_t ){
+        for( size_t i = next++; i < no_transforms; i = next++ ){
+            if( i > first_good ){ break; }
+            if( i > 0 && timed && chrono::steady_clock::now() >= deadline ){ break; }
+            evaluateTransformation( transformedModules[i], slots[i] );
+            slots[i].index  = i;
+            evaluated[i]    = 1;
+            if( !isGoodEnough( slots[i] )){ continue; }
+            // keep the lowest good enough index
+            size_t current = first_good;
+            while( i < current && !first_good.compare_exchange_weak( current, i )){}
         }
-        
-        std::vector< SubsetResult > results;
-        EdgeCost treshold = make_pair( 0.5, 0.5 );
+    });
+    
+    size_t end = std::min( no_transforms, first_good + 1 );
+    for( size_t i = 0; i < end; ++i ){
+        if( evaluated[i] ){ results.push_back( std::move( slots[i] )); }
+    }
+    if( first_good < no_transforms ){ ++timings.no_early_exits; }
+}
 
-        get_subsets( *mainStructure, transformedModules[i], current_matches, results, treshold );
-        
-        if( results.size() == 0 ){ /* std::cout << "result set is empty" << endl; */ continue; }
+
+// the rigid motion that best aligns the matched poles of the evaluated pose to their host poles.
+// each pole adds its position and a point along its normal, which has to land on the opposite side
+// of the host pole, so that the rotation about a single matched normal is constrained as well
+Mat4x4d StatefulEngine::alignMatchedPoles( const TransformEvaluation &e ) const{
+    const Mat4x4d&          T = e.mi.random_transform;
+    TransformedModuleView   view( *candidateModule, T );
+    double                  normal_offset = candidateModule->bsphere_radius / 4.0;
+    vector< Vec3d >         module_pos, host_pos;
+    
+    for( const Match& match : e.mi.matches ){
+        const PoleGeometryInfo& host_pgi = mainStructure->getPoleInfo( match.second ).geometry;
+        Vec3d m_pos = view.polePos( match.first ),
+              m_n   = view.poleNormal( match.first ),
+              h_n   = host_pgi.normal;
+        m_n.normalize();
+        h_n.normalize();
+        module_pos.push_back( m_pos );
+        host_pos.push_back( host_pgi.pos );
+        module_pos.push_back( m_pos + normal_offset * m_n );
+        host_pos.push_back( host_pgi.pos - normal_offset * h_n );
+    }
+    
+    Mat4x4d R, t;
+    svd_rigid_motion( module_pos, host_pos, R, t );
+    return t * R * T;
+}
+
+
+// the best valid poses are moved by alignMatchedPoles and evaluated again, a pose is refined as long as
+// it matches more poles or gets a lower fitting cost. The refined poses go through the collision culling
+// and count against the search budget like the others
+void StatefulEngine::refinePoses( vector< TransformEvaluation > &evaluations, Util::Timer &started ){
+    Util::Timer timer;
+    timer.start();
+    
+    // a single match is already aligned exactly by buildTransformationList
+    vector< size_t > order;
+    for( size_t i = 0; i < evaluations.size(); ++i ){
+        if( evaluations[i].isValid && evaluations[i].mi.matches.size() > 1 ){ order.push_back( i ); }
+    }
+    stable_sort( order.begin(), order.end(), [&evaluations]( size_t l, size_t r ){
+        return fitting_cost( evaluations[l].mi, evaluations[l].extendedCost ) <
+               fitting_cost( evaluations[r].mi, evaluations[r].extendedCost );
+    });
+    order.resize( std::min( order.size(), noRefinedPoses ));
+    
+    vector< TransformEvaluation >   refined;
+    vector< bool >                  improved( order.size(), false );
+    vector< size_t >                slots, next_slots, evaluated_slots;
+    for( size_t i = 0; i < order.size(); ++i ){
+        refined.push_back( evaluations[order[i]] );
+        slots.push_back( i );
+    }
+    
+    vector< Mat4x4d >               Ts;
+    vector< bool >                  colliding;
+    vector< TransformEvaluation >   results;
+    size_t                          no_evaluated = evaluations.size();
+    
+    for( size_t it = 0; it < noRefineIterations && !slots.empty(); ++it ){
+        if( searchBudget.maxSeconds > 0.0 && started.get_secs() >= searchBudget.maxSeconds ){ break; }
+        if( searchBudget.maxEvaluations > 0 ){
+            if( no_evaluated >= searchBudget.maxEvaluations ){ break; }
+            slots.resize( std::min( slots.size(), searchBudget.maxEvaluations - no_evaluated ));
+        }
         
-        // LEGACY
-        assert( results.size() == 1 || results.front().matches.size() > results.back().matches.size( ));
+        Ts.clear();
+        for( size_t slot : slots ){ Ts.push_back( alignMatchedPoles( refined[slot] )); }
+        if( cullCollisions ){ mainStructure->collidingPoses( *candidateModule, Ts, colliding, collisionTolerance ); }
+        else                { colliding.assign( Ts.size(), false ); }
         
-        best_matches = std::move( results.front().matches );
-        EdgeCost c   = results.front().cost;
+        size_t begin = transformedModules.size();
+        evaluated_slots.clear();
+        for( size_t k = 0; k < Ts.size(); ++k ){
+            if( colliding[k] ){ continue; }
+            transformedModules.push_back( TransformedModuleView( *candidateModule, Ts[k] ));
+            evaluated_slots.push_back( slots[k] );
+        }
+        evaluateTransformations( begin, transformedModules.size(), results );
+        no_evaluated            += results.size();
+        timings.no_evaluations  += results.size();
         
-        for( auto& match : best_matches ){
-            
-            double squared_dist = 0.0;
-            Vec3d d = transformedModules[i].getPoleInfo( match.first ).geometry.pos - mainStructure->getPoleInfo( match.second ).geometry.pos;
-            squared_dist = fabs( d[0] + d[1] + d[2] );
-            squared_dist /= 10E5;
-            distance_sum += squared_dist;
+        next_slots.clear();
+        for( TransformEvaluation& e : results ){
+            // the refined poses reach testMultipleTransformations, they must not be timed twice
+            timings.matching    += e.matchingTime;
+            timings.subsets     += e.subsetsTime;
+            e.matchingTime      = 0.0;
+            e.subsetsTime       = 0.0;
+            if( !e.isValid ){ continue; }
+            size_t                      slot    = evaluated_slots[e.index - begin];
+            const TransformEvaluation&  current = refined[slot];
+            size_t no_matches = e.mi.matches.size(), current_no_matches = current.mi.matches.size();
+            bool better = no_matches > current_no_matches ||
+                          ( no_matches == current_no_matches &&
+                            fitting_cost( e.mi, e.extendedCost ) < fitting_cost( current.mi, current.extendedCost ));
+            if( !better ){ continue; }
+            refined[slot]   = std::move( e );
+            improved[slot]  = true;
+            next_slots.push_back( slot );
         }
-
-        mi.cost     = c;
-        extendedCosts.push_back( make_pair( distance_sum, c ));
-#ifdef TRACE
-        cout << "configuration " << i << " has cost : "
-        << mi.cost.first << ", " << mi.cost.second << ", " << distance_sum << endl;
-#endif
-        mi.matches  = std::move( best_matches );
-        proposed_matches.push_back( std::move( mi ));
+        // the parallel evaluation does not keep the order
+        sort( next_slots.begin(), next_slots.end( ));
+        slots.swap( next_slots );
+    }
+    
+    for( size_t slot = 0; slot < refined.size(); ++slot ){
+        if( !improved[slot] ){ continue; }
+        evaluations.push_back( std::move( refined[slot] ));
+        ++timings.no_refined;
+    }
+    timings.refinement += timer.get_secs();
 }
+
+
+bool StatefulEngine::testMultipleTransformations(){
+        assert( this->m != NULL );
+    
+    vector< match_info >        proposed_matches;
+    vector< ExtendedCost >      extendedCosts;
+    vector< Mat4x4d >           Ts;
+    vector< pair< size_t, ExtendedCost >>   stats;
+    vector< TransformEvaluation >           evaluations;
+    
+    for( size_t d = 0; d < candidateModule->poleList.size(); ++d){ stats.push_back( make_pair( 0, make_pair( 0.0, make_pair( 0.0, 0.0 ))));}
+    
+    Util::Timer step_timer;
+    step_timer.start();
+    
+    Util::Timer timer;
+    timer.start();
+    buildTransformationList( Ts );
+    timings.transformList += timer.get_secs();
+    
+    if( cullCollisions ){
+        timer.start();
+        cullCollidingTransformations( Ts );
+        timings.collision += timer.get_secs();
+    }
+    timings.no_transforms += Ts.size();
+//    return;
+    
+    assert( candidateModule->getPoleTable().size() > 0 );
+    
+    if( searchBudget.isLimited( )){ evaluateWithinBudget( evaluations, step_timer ); }
+    else                           { evaluateTransformations( Ts, evaluations ); }
+    timings.no_evaluations += evaluations.size();
+    
+    if( poseSearchMode == Search_CoarseToFine ){ refinePoses( evaluations, step_timer ); }
+    
+    for( TransformEvaluation& e : evaluations ){
+        timings.matching    += e.matchingTime;
+        timings.subsets     += e.subsetsTime;
+        if( e.no_raw_matches > 0 ) { stats[e.no_raw_matches - 1].first++; }
+        if( !e.isValid ) { continue; }
+        
+        extendedCosts.push_back( e.extendedCost );
+        proposed_matches.push_back( std::move( e.mi ));
+    }
     
     if( proposed_matches.size() <= 0 ){
         cout << "unable to find a feasible solution of " << transformedModules.size() << " transformed modules " << endl;
@@ -698,8 +882,8 @@ bool StatefulEngine::testMultipleTransformations(){
          << " Proposed Matches " << endl;
     for( Match& match :  best_match.getMatchInfo().matches ){
         cout << match.first << " # " << match.second << endl;
-        Vec3d normal1 = vertex_normal( *m, match.first );
-        Vec3d normal2 = vertex_normal( *m, match.second );
+        Vec3d normal1 = TransformedModuleView( *candidateModule, best_match.getMatchInfo().random_transform ).poleNormal( match.first );
+        Vec3d normal2 = mainStructure->getPoleInfo( match.second ).geometry.normal;
         normal1.normalize();
         normal2.normalize();
         cout << "1) " << normal1 << endl << "2) " << normal2 << endl;
@@ -723,6 +907,12 @@ void StatefulEngine::glueModuleToHost(){
     actualGlueing();
 }
 
+// the poses are generated for every ( host pole, module pole ) pair that can match, sixteen rotations
+// about the host pole normal each ( noCoarseAngles with a coarse to fine search ). With a best first
+// search the pairs are sorted by the number of free poles found around the host pole within the reach
+// of the module pole ( its distance from the farthest module pole ). That number is only an estimate
+// of how many poles the pair can match, the pose search uses it to order the pairs and to know when
+// a match can not get any larger
 void StatefulEngine::buildTransformationList( vector< Mat4x4d> &transformations ){
 
     size_t skipped = 0;
@@ -731,7 +921,7 @@ void StatefulEngine::buildTransformationList( vector< Mat4x4d> &transformations
     cout << "Building transformations set " << endl;
 #endif
     
-    size_t no_M_poles = candidateModule->getPoleInfoMap().size();
+    size_t no_M_poles = candidateModule->getPoleTable().size();
     transformations.clear();
     
     const vector<VertexID> &_candidates = mainStructure->getFreePoles();
@@ -740,79 +930,128 @@ void StatefulEngine::buildTransformationList( vector< Mat4x4d> &transformations
     size_t no_m_poles    = candidateModule->poleList.size();
     size_t H_starter = randomizer() % no_candidates;
     Mat4x4d t_origin = translation_Mat4x4d( - candidateModule->bsphere_center );
+    // the first angle is always drawn among the sixteen exhaustive ones
+    double start_step = M_PI_4 / 2.0;
+    size_t no_angles  = ( poseSearchMode == Search_CoarseToFine ) ? noCoarseAngles : 16;
+    double step       = 2.0 * M_PI / no_angles;
+    
+    struct PosePair{
+        VertexID    H_pole, M_pole;
+        double      start_angle;
+        size_t      reach_score;
+    };
+    vector< PosePair > pairs;
+    
+    // reach of each module pole
+    vector< double > reach( no_m_poles, 0.0 );
+    double           max_reach = 0.0;
+    if( searchBudget.bestFirst ){
+        const PoleTable& M_poles = candidateModule->getPoleTable();
+        for( size_t j = 0; j < no_m_poles; ++j ){
+            const Vec3d& p = M_poles.pos( M_poles.slot( candidateModule->poleList[j] ));
+            for( const Vec3d& other : M_poles.getPositions( )){
+                reach[j] = std::max( reach[j], ( other - p ).length( ));
+            }
+            max_reach = std::max( max_reach, reach[j] );
+        }
+    }
+    vector< PoleGrid::IDDist > around;
     
     for( int i = 0; i < no_candidates; ++i ){
         
         size_t actual_i = ( i + H_starter ) % no_candidates;
         VertexID H_pole = _candidates[ actual_i ];
-//        VertexID H_pole = _candidates[ 0 ];
         
         const PoleInfo& H_pole_info = mainStructure->getPoleInfo(H_pole);
         
+        if( searchBudget.bestFirst ){
+            mainStructure->getPoleGrid().inSphere( H_pole_info.geometry.pos, max_reach + SUBSET_TRESHOLD.first,
+                                                   []( VertexID ){ return true; }, around );
+        }
+        
         size_t M_starter = randomizer() % no_M_poles;
         // MODULE POLES LOOP
         for( int j = 0; j < no_M_poles; ++j ){
             
-            Mat4x4d T;
             size_t actual_j = ( j + M_starter ) % no_m_poles;
             VertexID M_pole = candidateModule->poleList[ actual_j ];
-//            VertexID M_pole = candidateModule->poleList[ 0 ];
             
 #ifdef TRACE
             cout << " polo : " << M_pole << endl;
 #endif
 
-            assert( candidateModule->getPoleInfoMap().count(M_pole) > 0 );
+            assert( candidateModule->getPoleTable().count(M_pole) > 0 );
             const PoleInfo& pinfo  = candidateModule->getPoleInfo(M_pole);
             
             if( !( Module::poleCanMatch( pinfo, H_pole_info ))){
-                skipped += 16;
+                skipped += no_angles;
                 continue;
             }
             
-            // align normals
-            Mat4x4d t_align = alt_get_alignment_for_2_vectors( pinfo.geometry.normal, H_pole_info.geometry.normal );
+            PosePair pose_pair;
+            pose_pair.H_pole      = H_pole;
+            pose_pair.M_pole      = M_pole;
+            pose_pair.start_angle = ( randomizer() % 16 ) * start_step;
+            pose_pair.reach_score = no_m_poles;
+            if( searchBudget.bestFirst ){
+                size_t in_reach = 0;
+                for( const PoleGrid::IDDist& h : around ){
+                    if( h.second <= reach[actual_j] + SUBSET_TRESHOLD.first ){ ++in_reach; }
+                }
+                pose_pair.reach_score = std::min( in_reach, no_m_poles );
+            }
+            pairs.push_back( pose_pair );
+        }
+    }
+    
+    if( searchBudget.bestFirst ){
+        // stable, the pairs with the same score keep their random order
+        stable_sort( pairs.begin(), pairs.end(), []( const PosePair& l, const PosePair& r ){
+            return l.reach_score > r.reach_score;
+        });
+    }
+    poseMatchBound = pairs.empty() ? 0 : pairs.front().reach_score;
+    
+    for( const PosePair& pose_pair : pairs ){
+        
+        Mat4x4d T;
+        const PoleInfo& H_pole_info = mainStructure->getPoleInfo( pose_pair.H_pole );
+        const PoleInfo& pinfo       = candidateModule->getPoleInfo( pose_pair.M_pole );
+            
+        // align normals
+        Mat4x4d t_align = alt_get_alignment_for_2_vectors( pinfo.geometry.normal, H_pole_info.geometry.normal );
+        
+        Vec3d m_pole_step1 = ( t_align * t_origin ).mul_3D_point( pinfo.geometry.pos );
+
+        // generate K rotations along the candidate normal
+        double curr_angle = pose_pair.start_angle;
+
+        // build and save rotations
+        for ( size_t i = 0; i < no_angles; ++i, curr_angle +=step ) {
+            Mat4x4d rot = get_rotation_mat4d( H_pole_info.geometry.normal, curr_angle );
+            Vec3d m_pole_step2 = rot.mul_3D_point( m_pole_step1 );
             
-            Vec3d m_pole_step1 = ( t_align * t_origin ).mul_3D_point( pinfo.geometry.pos );
-
-            // generate K rotations along the candidate normal
-            double step = M_PI_4 / 2.0;
-//            double curr_angle = 0;
-            double curr_angle = ( randomizer() % 16 ) * step;
-
-            // build and save rotations
-            for ( int i = 0; i < 16; ++i, curr_angle +=step ) {
-                Mat4x4d rot = get_rotation_mat4d( H_pole_info.geometry.normal, curr_angle );
-                Vec3d m_pole_step2 = rot.mul_3D_point( m_pole_step1 );
-                
-                Vec3d   to_H_pole = H_pole_info.geometry.pos - m_pole_step2;
-                Mat4x4d tr_to_H_pole = translation_Mat4x4d( to_H_pole );
+            Vec3d   to_H_pole = H_pole_info.geometry.pos - m_pole_step2;
+            Mat4x4d tr_to_H_pole = translation_Mat4x4d( to_H_pole );
 #ifdef TRACE
-                cout << "rotation with axis " << H_pole_normal << " and angle : " << curr_angle << rot << endl;
-                cout << "Translate to pole " << endl << tr_to_H_pole << endl;
-                cout << "pole translated aligned rotated : " << m_pole_step2 << endl;
-                cout << "to_h_pole " << to_H_pole << endl
-                << "translation mat4 " << endl << tr_to_H_pole;
+            cout << "rotation with axis " << H_pole_normal << " and angle : " << curr_angle << rot << endl;
+            cout << "Translate to pole " << endl << tr_to_H_pole << endl;
+            cout << "pole translated aligned rotated : " << m_pole_step2 << endl;
+            cout << "to_h_pole " << to_H_pole << endl
+            << "translation mat4 " << endl << tr_to_H_pole;
 #endif
-                T = tr_to_H_pole * rot * t_align * t_origin;
+            T = tr_to_H_pole * rot * t_align * t_origin;
 
 #ifdef TRACE
-                cout << "complete transform" << endl <<  T;
+            cout << "complete transform" << endl <<  T;
 #endif
-                assert( !isnan( T[1][1] ));
-                
-                Module& t_module = this->candidateModule->getTransformedModule( T );
-                
-                // skip if there is a collision.
-                // need to improve it
-//                if( mainStructure->isColliding( t_module )){
-//                    cout << " skipping configuration - COLLISION " << endl;
-//                    continue;
-//                }
-
-                transformations.push_back( T );
-                transformedModules.push_back( t_module );
-            }
+            assert( !isnan( T[1][1] ));
+            
+            TransformedModuleView t_module( *candidateModule, T );
+            
+            // collisions are tested for the whole list at once, see cullCollidingTransformations
+            transformations.push_back( T );
+            transformedModules.push_back( t_module );
         }
     }
     
@@ -820,6 +1059,55 @@ void StatefulEngine::buildTransformationList( vector< Mat4x4d> &transformations
     cout << endl << transformations.size() << " configurations generated and " << skipped << " skipped" << endl;
 }
 
+// drops the transformations that make the candidate intersect the main structure,
+// the order of the remaining ones is preserved
+void StatefulEngine::cullCollidingTransformations( vector< Mat4x4d> &transformations ){
+    assert( transformations.size() == transformedModules.size( ));
+    
+    vector< bool > colliding;
+    mainStructure->collidingPoses( *candidateModule, transformations, colliding, collisionTolerance );
+    
+    size_t kept = 0;
+    for( size_t i = 0; i < transformations.size(); ++i ){
+        if( colliding[i] ){ continue; }
+        transformations[kept]       = transformations[i];
+        transformedModules[kept]    = transformedModules[i];
+        ++kept;
+    }
+    cout << transformations.size() - kept << " configurations skipped - COLLISION " << endl;
+    transformations.resize( kept );
+    transformedModules.resize( kept );
+}
+
 size_t StatefulEngine::noFreePoles(){
     return this->mainStructure->getFreePoles().size();
+}
+
+void StatefulEngine::setEvaluationMode( TransformEvaluationMode mode, size_t no_workers ){
+    evaluationMode  = mode;
+    noWorkers       = no_workers;
+}
+
+// the seed drives the order in which poles are visited and the starting angle of the rotations
+void StatefulEngine::setSeed( unsigned long seed ){
+    randomizer.seed( seed );
+}
+
+void StatefulEngine::setCollisionCulling( bool enabled, double tolerance ){
+    assert( tolerance >= 0.0 && tolerance < 1.0 );
+    cullCollisions      = enabled;
+    collisionTolerance  = tolerance;
+}
+
+void StatefulEngine::setPoseSearch( PoseSearchMode mode, size_t no_coarse_angles, size_t no_refined, size_t no_iterations ){
+    assert( no_coarse_angles > 0 );
+    poseSearchMode      = mode;
+    noCoarseAngles      = no_coarse_angles;
+    noRefinedPoses      = no_refined;
+    noRefineIterations  = no_iterations;
+}
+
+void StatefulEngine::setSearchBudget( const SearchBudget& budget ){
+    assert( budget.maxSeconds >= 0.0 );
+    searchBudget = budget;
 }
\ No newline at end of file
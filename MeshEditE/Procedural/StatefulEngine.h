@@ -12,6 +12,7 @@
 #include <stdio.h>
 #include <vector>
 #include <map>
+#include <memory>
 #include <random>
 #include <set>
 
@@ -21,10 +22,12 @@
 
 #include <GEL/CGLA/Vec3d.h>
 #include <GEL/CGLA/Mat4x4d.h>
+#include <GEL/Util/Timer.h>
 
 #include "MeshEditE/Procedural/Helpers/module_alignment.h"
-#include "MesheditE/Procedural/Module.h"
-#include "MesheditE/Procedural/MainStructure.h"
+#include "MeshEditE/Procedural/Module.h"
+#include "MeshEditE/Procedural/MainStructure.h"
+#include "MeshEditE/Procedural/TransformedModuleView.h"
 
 namespace GEL_Geometry = Geometry;
 
@@ -38,7 +41,6 @@ typedef std::vector<HMesh::VertexID>                                    VertexLi
 typedef std::map<HMesh::VertexID, CGLA::Vec3d>                          VertexPosMap;
 typedef std::set<HMesh::VertexID>                                       VertexSet;
 typedef std::map< HMesh::VertexID, HMesh::VertexID >                    VertexMatchMap;
-typedef GEL_Geometry::KDTree< CGLA::Vec3d, HMesh::VertexID >            kD_Tree;
         
 typedef std::pair< std::vector< Procedural::Match>,
                                 Procedural::GraphMatch::EdgeCost >      matchesAndCost;
@@ -82,6 +84,49 @@ struct MatchInfoProxy{
         }
 };
         
+/// outcome of the evaluation of a single candidate transformation
+struct TransformEvaluation{
+    Procedural::Helpers::ModuleAlignment::match_info    mi;
+    ExtendedCost                                        extendedCost;
+    size_t                                              no_raw_matches  = 0;    // matches before the graph pruning
+    bool                                                isValid         = false;
+    size_t                                              index           = 0;    // of the transformed module
+    double                                              matchingTime    = 0.0;
+    double                                              subsetsTime     = 0.0;
+};
+
+/// seconds spent in each phase since the last resetTimings.
+/// matching and subsets are summed over the evaluation workers, so they can exceed the wall time
+struct PhaseTimings{
+    double  transformList   = 0.0;
+    double  matching        = 0.0;
+    double  subsets         = 0.0;
+    double  collision       = 0.0;
+    double  refinement      = 0.0;  // wall time, evaluations of the refined poses included
+    double  glue            = 0.0;
+    double  bake            = 0.0;
+    size_t  no_transforms   = 0;
+    size_t  no_evaluations  = 0;    // less than no_transforms when the search is budgeted
+    size_t  no_early_exits  = 0;
+    size_t  no_refined      = 0;    // poses improved by the refinement
+    size_t  no_glueings     = 0;
+};
+
+/// limits of the pose search done by testMultipleTransformations, the default values evaluate
+/// every pose. The workers check the limits before each evaluation, so the time limit can be
+/// exceeded by at most one evaluation per worker.
+/// goodEnoughCost stops the search at the first pose that matches as many poles as the best
+/// ( module pole, host pole ) pair can reach and whose fitting cost is not above it.
+/// bestFirst evaluates first the pairs that have more host poles within the reach of the module
+struct SearchBudget{
+    size_t  maxEvaluations  = 0;        // 0 means no limit
+    double  maxSeconds      = 0.0;      // wall clock per step, 0 means no limit
+    double  goodEnoughCost  = -1.0;     // negative disables the early exit
+    bool    bestFirst       = false;
+    
+    inline bool isLimited() const { return maxEvaluations > 0 || maxSeconds > 0.0 || goodEnoughCost >= 0.0; }
+};
+
 struct CandidateInfo{
     HMesh::VertexID id;
 };
@@ -115,16 +160,37 @@ class StatefulEngine{
     
     enum DimensionalityConstraint { Constrained_1D, Constrained_2D, Constrained_3D };
     
+    public :
+    /// Serial       : one transformation after the other on the calling thread
+    /// Parallel     : workers of the thread pool pull transformations dynamically
+    /// Deterministic: each worker of the thread pool evaluates a fixed contiguous chunk
+    /// in every mode the results are written into per-transformation slots and reduced
+    /// in index order, so the selection is identical to the Serial one
+    enum TransformEvaluationMode { Evaluation_Serial, Evaluation_Parallel, Evaluation_Deterministic };
+    /// Exhaustive   : sixteen rotations about the host pole normal for each pair of poles
+    /// CoarseToFine : a few rotations per pair, then the best valid poses are refined by
+    ///                rigidly aligning their matched poles ( positions and normals ) and
+    ///                matching them again, as long as the match improves
+    enum PoseSearchMode { Search_Exhaustive, Search_CoarseToFine };
+    
     /************************************************
      * METHODS                                      *
      ***********************************************/
     public :
     static  StatefulEngine& getCurrentEngine();
+            /// host is where bake writes the structure, the engine keeps a copy of it for the
+            /// starting module. The previous host and structure are dropped, see reset
             void            setHost( HMesh::Manifold &host );
+            /// frees the main structure, the modules glued by the engine and the queued ones.
+            /// afterwards the engine does not reference the host given to setHost anymore
+            void            reset();
             void            setModule( Procedural::Module &module );
             bool            testMultipleTransformations();
             void            glueModuleToHost();
             void            consolidate();
+            /// the glued modules are kept as instances in the main structure, the host mesh
+            /// is rebuilt from them only here ( e.g. before displaying or saving it )
+            void            bake();
     
     
             void            applyRandomTransform();
@@ -134,7 +200,25 @@ class StatefulEngine{
             void            actualGlueing();
     
             void            glueCurrent();
+            /// aligns the current candidate and puts it into the glue queue, it returns false
+            /// ( and drops the candidate ) if one of its host poles is already used by a queued placement
+            /// or, when collision culling is enabled, if its skeleton intersects a queued one.
+            /// queued placements are not visible to the search until glueQueued is called
+            bool            queueCurrent();
+            void            glueQueued();
             size_t          noFreePoles();
+            void            setEvaluationMode( TransformEvaluationMode mode, size_t no_workers = 0 );
+            void            setSeed( unsigned long seed );
+            /// when enabled the poses that make the candidate intersect the main structure are dropped
+            /// before the matching, and queueCurrent rejects a candidate that intersects a queued module.
+            /// tolerance is the fraction of the skeleton balls allowed to overlap
+            void            setCollisionCulling( bool enabled, double tolerance = 0.1 );
+            void            setSearchBudget( const SearchBudget& budget );
+            void            setPoseSearch( PoseSearchMode mode, size_t no_coarse_angles = 4,
+                                           size_t no_refined = 8, size_t no_iterations = 4 );
+    
+            inline const PhaseTimings&  getTimings() const { return timings; }
+            inline void                 resetTimings() { timings = PhaseTimings(); }
     
             inline const MainStructure& getMainStructure() const{ return *mainStructure; };
     
@@ -148,15 +232,28 @@ class StatefulEngine{
             void            buildRandomRotation( CGLA::Mat4x4d &t );
 
             /*  INHERITED FROM module_alignment */
-            void            buildMainStructureKdTree();
 
-            void            matchModuleToHost( Module &candidate, VertexMatchMap& M_pole_to_H_vertex );
-            bool            findSecondClosest( const HMesh::VertexID &pole, const PoleGeometryInfo &pgi,
-                                               const HMesh::VertexID &closest, HMesh::VertexID &second_closest, VertexSet &assigned );
+            void            matchModuleToHost( const TransformedModuleView &candidate, std::vector< Match >& M_to_H );
     
             void            buildTransformationList( std::vector< CGLA::Mat4x4d> &transformations );
+            void            cullCollidingTransformations( std::vector< CGLA::Mat4x4d> &transformations );
+            Module&         placedCandidate();
             size_t          chooseBestFitting( const std::vector< Procedural::Helpers::ModuleAlignment::match_info > proposed_matches,
                                                const std::vector< ExtendedCost > extendedCosts ) const;
+            void            evaluateTransformation( const TransformedModuleView &transformed, TransformEvaluation &result );
+            void            evaluateTransformations( const std::vector< CGLA::Mat4x4d > &Ts,
+                                                     std::vector< TransformEvaluation > &results );
+            /// evaluates the transformed modules in [begin, end)
+            void            evaluateTransformations( size_t begin, size_t end,
+                                                     std::vector< TransformEvaluation > &results );
+            /// evaluates the transformed modules in order until the search budget is used up or
+            /// a good enough pose is found. started is the time the step began at
+            void            evaluateWithinBudget( std::vector< TransformEvaluation > &results, Util::Timer &started );
+            bool            isGoodEnough( const TransformEvaluation &e ) const;
+            /// appends to evaluations the refined version of the best ones that could be improved
+            void            refinePoses( std::vector< TransformEvaluation > &evaluations, Util::Timer &started );
+            CGLA::Mat4x4d   alignMatchedPoles( const TransformEvaluation &e ) const;
+            size_t          noEvaluationThreads( size_t no_transforms ) const;
 
 
     
@@ -169,18 +266,24 @@ class StatefulEngine{
 //private:
 public:
     HMesh::Manifold     *m;
-
-    VertexSet           M_vertices;
+    bool                hostIsBaked;    // false if m does not show the last glued modules
+    std::vector<Procedural::Placement>
+                        glueQueue;
 
     
-    Procedural::MainStructure*  mainStructure;
+    std::unique_ptr<Procedural::MainStructure>  mainStructure;
+    // the copy of the host the starting module is built on
+    std::unique_ptr<HMesh::Manifold>            hostCopy;
+    // the modules in mainStructure, the starting one included. The structure does not free them
+    std::vector<Procedural::Module*>            gluedModules;
     Procedural::Module*         candidateModule;
     
-    std::vector<Procedural::Module>
+    // the module copy that is going to be glued is made only once, by placedCandidate
+    bool                candidateIsPlaced;
+    
+    std::vector<Procedural::TransformedModuleView>
                         transformedModules;
 
-    kD_Tree*            tree;
-    bool                treeIsValid;
     
     
     MatchInfoProxy      best_match;
@@ -188,6 +291,22 @@ public:
     std::mt19937_64     randomizer;
     double              last_x1, last_x2, last_x3;
     size_t              current_glueing_target;
+    
+    TransformEvaluationMode evaluationMode;
+    size_t              noWorkers;      // 0 means one worker per thread of the pool
+    
+    bool                cullCollisions;
+    double              collisionTolerance;
+    
+    SearchBudget        searchBudget;
+    size_t              poseMatchBound; // most poles a pose of the current list can match
+    
+    PoseSearchMode      poseSearchMode;
+    size_t              noCoarseAngles;
+    size_t              noRefinedPoses;
+    size_t              noRefineIterations;
+    
+    PhaseTimings        timings;
 
 
 };
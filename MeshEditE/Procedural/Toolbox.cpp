@@ -12,8 +12,11 @@
 #include <fstream>
 #include <streambuf>
 #include <iostream>
+#include <chrono>
+#include <stdexcept>
 
 #include "Helpers/misc.h"
+#include <MeshEditE/HMeshParallelKit.h>
 
 #include <GEL/HMesh/obj_load.h>
 
@@ -30,6 +33,11 @@ namespace Procedural {
         unsigned seed   = chrono::system_clock::now().time_since_epoch().count();
         randomizer.seed( seed );
         rand_max =  static_cast<float>( randomizer.max( ));
+        total_pieces = 0;
+    }
+    
+    void Toolbox::setSeed( unsigned long seed ){
+        randomizer.seed( seed );
     }
     
     Toolbox& Toolbox::getToolboxInstance(){
@@ -37,47 +45,90 @@ namespace Procedural {
         return instance;
     }
     
-    /// Loads a toolbox from a JSON configuration file
-    void Toolbox::fromJson( std::string path ){
+    /// Loads a toolbox from a JSON configuration file. The modules are built in parallel and
+    /// added in the order of the file, the ones that cannot be loaded are reported and skipped.
+    /// Returns false if the file or any of the modules could not be loaded
+    bool Toolbox::fromJson( std::string path ){
+        
+        struct Entry{
+            string      filename, config, name, error;
+            Moduletype  type;
+            double      probability;
+            int         no_pieces, no_glueings;
+            Module*     module = NULL;
+        };
         
         std::cout << path;
         std::ifstream t( path );
-        assert( t.good() );
+        if( !t.good( )){
+            cerr << "toolbox : cannot open " << path << endl;
+            return false;
+        }
         std::string json( (std::istreambuf_iterator<char>(t)),
                           std::istreambuf_iterator<char>());
         
         rapidjson::Document d;
         d.Parse( json.c_str() );
+        if( d.HasParseError() || !d.IsObject() || !d.HasMember( "toolbox" ) || !d["toolbox"].IsArray( )){
+            cerr << "toolbox : " << path << " is not a valid toolbox file" << endl;
+            return false;
+        }
         rapidjson::Value &tb = d["toolbox"];
-        assert( tb.IsArray() );
         
+        vector< Entry > entries( tb.Size( ));
         for( rapidjson::SizeType i = 0; i < tb.Size(); ++i ){
-            assert( tb[i].HasMember( "filename" ));
-            assert( tb[i].HasMember( "config" ));
-            assert( tb[i].HasMember( "type" ));
-            assert( tb[i].HasMember( "probability" ));
-            assert( tb[i].HasMember( "no_pieces" ));
-            assert( tb[i].HasMember( "no_glueings" ));
+            Entry& e = entries[i];
+            if( !tb[i].IsObject() ||
+                !tb[i].HasMember( "filename" )      || !tb[i]["filename"].IsString()    ||
+                !tb[i].HasMember( "config" )        || !tb[i]["config"].IsString()      ||
+                !tb[i].HasMember( "type" )          || !tb[i]["type"].IsInt()           ||
+                !tb[i].HasMember( "probability" )   || !tb[i]["probability"].IsNumber() ||
+                !tb[i].HasMember( "no_pieces" )     || !tb[i]["no_pieces"].IsInt()      ||
+                !tb[i].HasMember( "no_glueings" )   || !tb[i]["no_glueings"].IsInt( )){
+                e.error = "malformed entry";
+                continue;
+            }
             
-            string mFilename    = tb[i]["filename"].GetString();
-            string mConfig      = tb[i]["config"].GetString();
-            Moduletype mType    = tb[i]["type"].GetInt();
-            double mProbability = tb[i]["probability"].GetDouble();
-            int    mNoPieces    = tb[i]["no_pieces"].GetInt();
-            int    mNoGlueings  = tb[i]["no_glueings"].GetInt();
+            e.filename      = tb[i]["filename"].GetString();
+            e.config        = tb[i]["config"].GetString();
+            e.type          = tb[i]["type"].GetInt();
+            e.probability   = tb[i]["probability"].GetDouble();
+            e.no_pieces     = tb[i]["no_pieces"].GetInt();
+            e.no_glueings   = tb[i]["no_glueings"].GetInt();
+        }
+        
+        // modules are independent, each one is built by a single thread of the pool
+        parallel_for( size_t( 0 ), entries.size(), [&]( size_t i ){
+            Entry& e = entries[i];
+            if( !e.error.empty( )){ return; }
+            try{
+                e.module = new Module( e.filename, e.config, e.type );
+            }
+            catch( const exception& ex ){
+                e.error = ex.what();
+            }
+        }, 1 );
+        
+        bool all_loaded = true;
+        for( size_t i = 0; i < entries.size(); ++i ){
+            Entry& e = entries[i];
+            if( e.module == NULL ){
+                cerr << "toolbox : module " << i << " ( " << e.filename << " ) not loaded : " << e.error << endl;
+                all_loaded = false;
+                continue;
+            }
             
-            // get the name of the module
-            string mName = Procedural::Helpers::Misc::get_filename_stem( mFilename );
-
             ModuleInfo* mInfo = new ModuleInfo;
-            mInfo->m                    = new Module( mFilename, mConfig, mType);
-            mInfo->m->no_of_glueings    = mNoGlueings;
-            mInfo->no_pieces            = mNoPieces;
-            mInfo->probability          = mProbability;
-            mInfo->name                 = mName;
+            mInfo->m                    = e.module;
+            mInfo->m->no_of_glueings    = e.no_glueings;
+            mInfo->no_pieces            = e.no_pieces;
+            mInfo->probability          = e.probability;
+            // get the name of the module
+            mInfo->name                 = Procedural::Helpers::Misc::get_filename_stem( e.filename );
             this->modules.push_back( mInfo );
-            total_pieces += mNoPieces;
+            total_pieces += e.no_pieces;
         }
+        return all_loaded;
     }
     
     void Toolbox::clear(){
@@ -31,10 +31,11 @@ class Toolbox{
         Module& getNext();
 
         void addModule( std::string path, size_t no_pieces );
-        void fromJson( std::string path );
+        bool fromJson( std::string path );
         void clear();
         void undoLast();
         void print() const;
+        void setSeed( unsigned long seed );
     
         inline size_t noRemainingPieces() const { return total_pieces; }
 
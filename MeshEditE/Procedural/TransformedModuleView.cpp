@@ -0,0 +1,31 @@
+//
+//  TransformedModuleView.cpp
+//  MeshEditE
+//
+
+#include "TransformedModuleView.h"
+#include "Test.h"
+
+using namespace std;
+using namespace HMesh;
+using namespace CGLA;
+
+namespace Procedural{
+
+Vec3d TransformedModuleView::polePos( VertexID p ) const{
+    return slotPos( getPoleTable().slot( p ));
+}
+
+Vec3d TransformedModuleView::poleNormal( VertexID p ) const{
+    return slotNormal( getPoleTable().slot( p ));
+}
+
+Vec3d TransformedModuleView::slotPos( PoleTable::Slot s ) const{
+    return T.mul_3D_point( getPoleTable().pos( s ));
+}
+
+Vec3d TransformedModuleView::slotNormal( PoleTable::Slot s ) const{
+    return mul_3D_dir( T, getPoleTable().normal( s ));
+}
+
+}
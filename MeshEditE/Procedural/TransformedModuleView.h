@@ -0,0 +1,47 @@
+//
+//  TransformedModuleView.h
+//  MeshEditE
+//
+
+#ifndef __MeshEditE__TransformedModuleView__
+#define __MeshEditE__TransformedModuleView__
+
+#include <stdio.h>
+
+#include <GEL/HMesh/Manifold.h>
+#include <GEL/CGLA/Vec3d.h>
+#include <GEL/CGLA/Mat4x4d.h>
+
+#include "Module.h"
+
+namespace Procedural{
+
+/// a module seen through a rigid transformation.
+/// nothing is copied from the base module, pole positions and normals are transformed on demand.
+/// the base module must outlive the view
+class TransformedModuleView{
+
+public:
+    TransformedModuleView() : module( NULL ) {}
+    TransformedModuleView( const Module &base, const CGLA::Mat4x4d &T ) : module( &base ), T( T ) {}
+
+    inline const Module&         getModule()    const { assert( module != NULL ); return *module; }
+    inline const CGLA::Mat4x4d&  getTransform() const { return T; }
+    inline const PoleList&       getPoleList()  const { return getModule().poleList; }
+    inline const PoleTable&      getPoleTable() const { return getModule().getPoleTable(); }
+    inline bool                  isPole( HMesh::VertexID v ) const { return ( getModule().getPoleTable().count( v ) > 0 ); }
+
+    CGLA::Vec3d         polePos( HMesh::VertexID p ) const;
+    CGLA::Vec3d         poleNormal( HMesh::VertexID p ) const;
+    // same as above for the pole in slot s of getPoleTable()
+    CGLA::Vec3d         slotPos( PoleTable::Slot s ) const;
+    CGLA::Vec3d         slotNormal( PoleTable::Slot s ) const;
+
+private:
+    const Module        *module;
+    CGLA::Mat4x4d       T;
+};
+
+}
+
+#endif /* defined(__MeshEditE__TransformedModuleView__) */
@@ -9,80 +9,118 @@
 #include <stdio.h>
 #include "collision_detection.h"
 
+using namespace CGLA;
+
 namespace Procedural{
-bool collide( const Skeleton& main, const Skeleton& other ){
     
-    const ShapeBall& main_cd    = main.getCdHierarchy(),
-    other_cd   = other.getCdHierarchy();
+namespace{
     
-#warning it should be an in-order visit, for now it is a level-visit
+struct Unmoved{
+    const Ball& operator()( const Ball& b ) const { return b; }
+};
+
+struct Moved{
+    const Mat4x4d& T;
+    Ball operator()( const Ball& b ) const {
+        Ball r;
+        r.center = T.mul_3D_point( b.center );
+        r.radius = b.radius;
+        return r;
+    }
+};
     
-    // if there is no collision between the bounding spheres I can safely return false
-    if( !ball_collide( main_cd.ball, other_cd.ball )){ return false; }
+// simultaneous descent of the two BVHs. A pair of tree nodes is discarded as soon as
+// their balls do not overlap, the first pair of overlapping skeleton balls ends the visit.
+// place moves the balls of other, shrink scales the skeleton balls ( not the tree ones,
+// they have to stay conservative )
+template< typename Placement >
+bool descend( const Skeleton& main, const Skeleton& other, const Placement& place, double shrink ){
     
-    std::vector< std::pair< NodeID, NodeID > >      joints_to_test;
-    std::set< std::pair< BoneID, BoneID > >         bones_to_test;
-    size_t tests, j_tests, b_tests, n_tests;
+    const BallTree& main_bvh    = main.bvh,
+                  & other_bvh   = other.bvh;
     
+    if( main_bvh.empty() || other_bvh.empty( )){ return false; }
     
-    for( const auto& item : main_cd.joints ){
-        for( const auto& other_item : other_cd.joints ){
-            ++tests;
-            ++j_tests;
-            if( ball_collide( item.second.ball, other_item.second.ball )){
-                joints_to_test.push_back( std::make_pair( item.first, other_item.first ) );
-            }
-        }
-    }
-    // for each pair of joints to test, check which pair of bones should be tested
-    for( const auto& item : joints_to_test ){
-        for( BoneID bm : main_cd.joints.at( item.first ).incidentBones ){
-            assert( main_cd.bones.count( bm ) > 0 );
-            const Ball b1 = main_cd.bones.at( bm ).ball;
-            
-            for( BoneID bo : other_cd.joints.at( item.second ).incidentBones ){
-                assert( other_cd.bones.count( bm ) > 0 );
-                const Ball b2 = other_cd.bones.at( bo ).ball;
-                
-                ++tests;
-                ++b_tests;
-                
-                if( ball_collide( b1, b2) ){
-                    bones_to_test.insert( std::make_pair( bm, bo ) );
+    std::vector< std::pair< int, int > > to_visit;
+    to_visit.reserve( 64 );
+    to_visit.push_back( std::make_pair( main_bvh.root, other_bvh.root ));
+    
+    while( !to_visit.empty( )){
+        std::pair< int, int > item = to_visit.back();
+        to_visit.pop_back();
+        
+        const BallTreeNode& a = main_bvh.tree[item.first],
+                          & b = other_bvh.tree[item.second];
+        
+        if( !ball_collide( a.ball, place( b.ball ))){ continue; }
+        
+        if( a.isLeaf() && b.isLeaf( )){
+            for( size_t i = a.first; i < a.first + a.count; ++i ){
+                Ball b1 = main.nodes[main_bvh.items[i]].ball;
+                b1.radius *= shrink;
+                for( size_t j = b.first; j < b.first + b.count; ++j ){
+                    Ball b2 = place( other.nodes[other_bvh.items[j]].ball );
+                    b2.radius *= shrink;
+                    if( ball_collide( b1, b2 )){ return true; }
                 }
             }
+            continue;
         }
-    }
-    for( const auto& item : bones_to_test ){
-        for( NodeID nm : main_cd.bones.at( item.first ).nodes ){
-            assert( nm >= 0 && nm < main.nodes.size( ));
-            const Ball b1 = main.nodes.at( nm ).ball;
-            
-            for( NodeID no : other_cd.bones.at( item.second ).nodes ){
-                assert( no >= 0 && no < other.nodes.size( ));
-                const Ball b2 = other.nodes.at( no ).ball;
-                ++tests;
-                ++n_tests;
-                if( ball_collide( b1, b2) ){
-                    std::cout << "T : " << tests << " # J : " << j_tests <<
-                    " # B : " << b_tests << " # N " << n_tests << std::endl;
-                    std::cout << " no joints : ( " << main_cd.joints.size()  << ", " << other_cd.joints.size()   << " ) " << std::endl;
-                    std::cout << " no bones  : ( " << main_cd.bones.size()   << ", " << other_cd.bones.size()    << " ) " << std::endl;
-                    std::cout << " no nodes  : ( " << main.nodes.size()      << ", " << other.nodes.size()       << " ) " << std::endl;
-                    
-                    return true;
-                }
-            }
+        
+        // descend into the bigger ball, so that both sides shrink at the same pace
+        if( b.isLeaf() || ( !a.isLeaf() && a.ball.radius >= b.ball.radius )){
+            to_visit.push_back( std::make_pair( a.left,  item.second ));
+            to_visit.push_back( std::make_pair( a.right, item.second ));
+        }
+        else{
+            to_visit.push_back( std::make_pair( item.first, b.left  ));
+            to_visit.push_back( std::make_pair( item.first, b.right ));
         }
     }
+    return false;
+}
     
-    std::cout << "T : " << tests << " # J : " << j_tests <<
-    " # B : " << b_tests << " # N " << n_tests << std::endl;
-    std::cout << " no joints : ( " << main_cd.joints.size()  << ", " << other_cd.joints.size()   << " ) " << std::endl;
-    std::cout << " no bones  : ( " << main_cd.bones.size()   << ", " << other_cd.bones.size()    << " ) " << std::endl;
-    std::cout << " no nodes  : ( " << main.nodes.size()      << ", " << other.nodes.size()       << " ) " << std::endl;
+}
     
+bool collide( const Skeleton& main, const Skeleton& other ){
+    return descend( main, other, Unmoved(), 1.0 );
+}
     
-    return false;
+bool collide( const Skeleton& main, const Skeleton& other, const Mat4x4d& T, double tolerance ){
+    Moved place = { T };
+    return descend( main, other, place, 1.0 - tolerance );
+}
+    
+void collide( const Skeleton& main, const Skeleton& other, const std::vector< Mat4x4d >& poses,
+              std::vector< bool >& colliding, double tolerance ){
+    
+    size_t no_poses = poses.size();
+    colliding.assign( no_poses, false );
+    if( main.bvh.empty() || other.bvh.empty( )){ return; }
+    
+    const Ball& main_root   = main.bvh.tree[main.bvh.root].ball;
+    const Ball& other_root  = other.bvh.tree[other.bvh.root].ball;
+    
+    // root against root for every pose, laid out as plain arrays so that the test vectorizes
+    std::vector< double >   cx( no_poses ), cy( no_poses ), cz( no_poses );
+    std::vector< char >     overlap( no_poses );
+    for( size_t i = 0; i < no_poses; ++i ){
+        Vec3d c = poses[i].mul_3D_point( other_root.center );
+        cx[i] = c[0];
+        cy[i] = c[1];
+        cz[i] = c[2];
+    }
+    
+    const double mx = main_root.center[0], my = main_root.center[1], mz = main_root.center[2];
+    const double rr = ( main_root.radius + other_root.radius ) * ( main_root.radius + other_root.radius );
+    for( size_t i = 0; i < no_poses; ++i ){
+        double dx = cx[i] - mx, dy = cy[i] - my, dz = cz[i] - mz;
+        overlap[i] = ( dx * dx + dy * dy + dz * dz ) < rr;
+    }
+    
+    for( size_t i = 0; i < no_poses; ++i ){
+        if( !overlap[i] ){ continue; }
+        colliding[i] = collide( main, other, poses[i], tolerance );
+    }
 }
 }
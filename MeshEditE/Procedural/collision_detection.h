@@ -12,6 +12,7 @@
 #include "pam_skeleton.h"
 
 #include <set>
+#include <vector>
 
 namespace Procedural{
     
@@ -21,6 +22,15 @@ namespace Procedural{
     }
     
     bool collide( const Skeleton& main, const Skeleton& other );
+    
+    // other is moved by the rigid transformation T. The skeleton balls are shrunk by
+    // ( 1 - tolerance ) before being tested, so that touching modules do not collide
+    bool collide( const Skeleton& main, const Skeleton& other, const CGLA::Mat4x4d& T, double tolerance = 0.0 );
+    
+    // colliding[i] is set to true if other, moved by poses[i], collides with main.
+    // The root balls are tested for all the poses at once, only the survivors are visited
+    void collide( const Skeleton& main, const Skeleton& other, const std::vector< CGLA::Mat4x4d >& poses,
+                  std::vector< bool >& colliding, double tolerance = 0.0 );
 }
 
-#endif
\ No newline at end of file
+#endif
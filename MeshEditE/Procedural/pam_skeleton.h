@@ -15,6 +15,7 @@
 #include <set>
 #include <fstream>
 #include <iostream>
+#include <algorithm>
 #include <unordered_map>
 
 #include <GEL/HMesh/Manifold.h>
@@ -22,6 +23,7 @@
 #include <GEL/CGLA/Mat4x4d.h>
 
 #include "polarize.h"
+#include "PoleTable.h"
 
 namespace Procedural{
     typedef size_t NodeID;
@@ -34,7 +36,7 @@ namespace Procedural{
     /***************************************/
     struct Ball{
         CGLA::Vec3d center;
-        double      radius;
+        double      radius = 0.0;
         
         void transform( const CGLA::Mat4x4d& T ){
             center = T.mul_3D_point( center );
@@ -86,6 +88,183 @@ namespace Procedural{
         }
     };
     
+    /***************************************/
+    /*     Bounding Volume Hierarchy       */
+    /***************************************/
+    struct BallTreeNode{
+        Ball        ball;
+        int         left    = -1;   // children are indices in BallTree::tree, -1 for leaves
+        int         right   = -1;
+        int         parent  = -1;
+        size_t      first   = 0;    // leaves only : range of BallTree::items
+        size_t      count   = 0;
+        
+        bool isLeaf() const { return ( left < 0 ); }
+    };
+    
+    // compact BVH over the balls of the skeleton nodes, built with median splits
+    // along the widest axis. Nodes added later ( e.g. by Skeleton::merge ) are
+    // inserted as a whole subtree, the tree is rebuilt only when it gets too deep.
+    struct BallTree{
+        static const size_t         LEAF_SIZE = 4;
+        std::vector< BallTreeNode > tree;
+        std::vector< NodeID >       items;  // skeleton nodes, each leaf owns a contiguous range
+        std::vector< int >          leafOf; // leaf containing each skeleton node
+        int                         root    = -1;
+        
+        bool empty() const { return tree.empty(); }
+        
+        void clear(){
+            tree.clear();
+            items.clear();
+            leafOf.clear();
+            root = -1;
+        }
+        
+        void build( const std::vector< SkelNode >& nodes ){
+            clear();
+            if( nodes.empty( )){ return; }
+            items.reserve( nodes.size( ));
+            for( NodeID i = 0; i < nodes.size(); ++i ){ items.push_back( i ); }
+            leafOf.resize( nodes.size( ));
+            tree.reserve( 2 * ( nodes.size() / LEAF_SIZE + 1 ));
+            root = buildRange( nodes, 0, items.size( ));
+        }
+        
+        // adds the skeleton nodes from first_new on. They are expected to be close to each other
+        // ( they come from the same module ), so they get their own subtree that is attached
+        // where it enlarges the enclosing balls the least
+        void insert( const std::vector< SkelNode >& nodes, NodeID first_new ){
+            if( first_new >= nodes.size( )){ return; }
+            if( empty( )){ build( nodes ); return; }
+            
+            size_t first_item = items.size();
+            for( NodeID i = first_new; i < nodes.size(); ++i ){ items.push_back( i ); }
+            leafOf.resize( nodes.size( ));
+            int         subtree = buildRange( nodes, first_item, items.size( ));
+            const Ball  b       = tree[subtree].ball;
+            
+            // choose the sibling
+            int     sibling = root;
+            size_t  depth   = 0;
+            while( !tree[sibling].isLeaf( )){
+                const BallTreeNode& n = tree[sibling];
+                double combined     = enclose( n.ball, b ).radius;
+                double inheritance  = combined - n.ball.radius;
+                double cost_left    = enclose( tree[n.left].ball, b ).radius + inheritance;
+                double cost_right   = enclose( tree[n.right].ball, b ).radius + inheritance;
+                if( !tree[n.left].isLeaf( )) { cost_left  -= tree[n.left].ball.radius; }
+                if( !tree[n.right].isLeaf( )){ cost_right -= tree[n.right].ball.radius; }
+                
+                if( combined < cost_left && combined < cost_right ){ break; }
+                sibling = ( cost_left < cost_right ) ? n.left : n.right;
+                ++depth;
+            }
+            
+            // the new parent takes the place of the sibling
+            int parent          = static_cast<int>( tree.size( ));
+            int old_parent      = tree[sibling].parent;
+            tree.push_back( BallTreeNode( ));
+            tree[parent].left   = sibling;
+            tree[parent].right  = subtree;
+            tree[parent].parent = old_parent;
+            tree[sibling].parent = parent;
+            tree[subtree].parent = parent;
+            if( old_parent < 0 ){ root = parent; }
+            else if( tree[old_parent].left == sibling ){ tree[old_parent].left  = parent; }
+            else                                       { tree[old_parent].right = parent; }
+            refitUpwards( parent );
+            
+            // unbalanced after many insertions, start again
+            size_t max_depth = 4;
+            for( size_t k = items.size() / LEAF_SIZE; k > 0; k >>= 1 ){ max_depth += 2; }
+            if( depth + subtreeDepth( subtree ) > max_depth ){ build( nodes ); }
+        }
+        
+        // to be called when the ball of a skeleton node changed
+        void refit( const std::vector< SkelNode >& nodes, NodeID n ){
+            assert( n < leafOf.size( ));
+            BallTreeNode& leaf = tree[leafOf[n]];
+            Ball b = nodes[items[leaf.first]].ball;
+            for( size_t i = leaf.first + 1; i < leaf.first + leaf.count; ++i ){ b = enclose( b, nodes[items[i]].ball ); }
+            leaf.ball = b;
+            refitUpwards( leaf.parent );
+        }
+        
+        // rigid transformations only, radii are not scaled
+        void transform( const CGLA::Mat4x4d& T ){
+            for( BallTreeNode& n : tree ){ n.ball.transform( T ); }
+        }
+        
+        // smallest ball enclosing both balls
+        static Ball enclose( const Ball& b1, const Ball& b2 ){
+            CGLA::Vec3d dir     = b2.center - b1.center;
+            double      dist    = dir.length();
+            if( dist + b2.radius <= b1.radius ){ return b1; }
+            if( dist + b1.radius <= b2.radius ){ return b2; }
+            
+            Ball b;
+            b.radius = ( dist + b1.radius + b2.radius ) * 0.5;
+            b.center = b1.center + dir * (( b.radius - b1.radius ) / dist );
+            return b;
+        }
+        
+    private:
+        void refitUpwards( int id ){
+            for( ; id >= 0; id = tree[id].parent ){
+                tree[id].ball = enclose( tree[tree[id].left].ball, tree[tree[id].right].ball );
+            }
+        }
+        
+        size_t subtreeDepth( int id ) const {
+            if( tree[id].isLeaf( )){ return 1; }
+            return 1 + std::max( subtreeDepth( tree[id].left ), subtreeDepth( tree[id].right ));
+        }
+        
+        int buildRange( const std::vector< SkelNode >& nodes, size_t first, size_t last ){
+            int id = static_cast<int>( tree.size( ));
+            tree.push_back( BallTreeNode( ));
+            
+            if( last - first <= LEAF_SIZE ){
+                Ball b = nodes[items[first]].ball;
+                for( size_t i = first + 1; i < last; ++i ){ b = enclose( b, nodes[items[i]].ball ); }
+                tree[id].ball   = b;
+                tree[id].first  = first;
+                tree[id].count  = last - first;
+                for( size_t i = first; i < last; ++i ){ leafOf[items[i]] = id; }
+                return id;
+            }
+            
+            // split at the median along the widest axis of the centers
+            CGLA::Vec3d lo = nodes[items[first]].ball.center, hi = lo;
+            for( size_t i = first + 1; i < last; ++i ){
+                const CGLA::Vec3d& c = nodes[items[i]].ball.center;
+                for( int k = 0; k < 3; ++k ){
+                    if( c[k] < lo[k] ){ lo[k] = c[k]; }
+                    if( c[k] > hi[k] ){ hi[k] = c[k]; }
+                }
+            }
+            CGLA::Vec3d extent  = hi - lo;
+            int         axis    = 0;
+            if( extent[1] > extent[axis] ){ axis = 1; }
+            if( extent[2] > extent[axis] ){ axis = 2; }
+            
+            size_t mid = ( first + last ) / 2;
+            std::nth_element( items.begin() + first, items.begin() + mid, items.begin() + last,
+                             [&nodes, axis]( NodeID a, NodeID b ){
+                                 return nodes[a].ball.center[axis] < nodes[b].ball.center[axis]; });
+            
+            int left    = buildRange( nodes, first, mid );
+            int right   = buildRange( nodes, mid, last );
+            tree[id].left       = left;
+            tree[id].right      = right;
+            tree[left].parent   = id;
+            tree[right].parent  = id;
+            tree[id].ball       = enclose( tree[left].ball, tree[right].ball );
+            return id;
+        }
+    };
+    
     struct SkelBone{
         BoneID                  ID;
         std::vector<NodeID>   nodes;
@@ -213,55 +392,86 @@ namespace Procedural{
             return ok;
         }
         
-        void mergeCollisionDetectionHierarchy(){
-#warning this should actually merge?
-            this->cd_hierarchy = NULL;
-            buildCollisionDetectionHierarchy();
+        // updates the hierarchy after a merge : the bones extended by the glueing are refitted, the
+        // bones and nodes coming from the other skeleton are inserted, nothing else is touched
+        void mergeCollisionDetectionHierarchy( NodeID first_new_node, BoneID first_new_bone,
+                                               const std::vector< BoneID >& extended_bones,
+                                               const std::vector< NodeID >& changed_nodes ){
+            if( cd_hierarchy == NULL || bvh.empty( )){
+                buildCollisionDetectionHierarchy();
+                return;
+            }
+            
+            for( BoneID b : extended_bones ){ fitBoneBall( b ); }
+            for( BoneID b = first_new_bone; b < bones.size(); ++b ){ fitBoneBall( b ); }
+            
+            for( NodeID n = first_new_node; n < nodes.size(); ++n ){
+                if( nodes[n].isBranching( )){ fitJointBall( n ); }
+            }
+            for( BoneID b : extended_bones ){
+                if( nodes[bones[b].nodes.front()].isBranching( )){ fitJointBall( bones[b].nodes.front( )); }
+                if( nodes[bones[b].nodes.back()].isBranching( )) { fitJointBall( bones[b].nodes.back( )); }
+            }
+            
+            for( NodeID n : changed_nodes ){ bvh.refit( nodes, n ); }
+            bvh.insert( nodes, first_new_node );
+            
+            bounding_sphere     = BallTree::enclose( bounding_sphere, bvh.tree[bvh.root].ball );
+            cd_hierarchy->ball  = bounding_sphere;
+        }
+        
+        void fitBoneBall( BoneID id ){
+            const SkelBone& b       = bones[id];
+            double          radius  = ( nodes.at( b.nodes.front( )).ball.center - nodes.at( b.nodes.back( )).ball.center ).length() ;
+            CGLA::Vec3d     centroid( 0.0 );
+            const SkelNode& start   = nodes[b.nodes.front()];
+            BoneBall&       bb      = cd_hierarchy->bones[b.ID];
+            bb.ID = b.ID;
+            bb.nodes.clear();
+            
+            for( NodeID nid : b.nodes ){
+                const SkelNode& node = nodes[nid];
+                centroid += node.ball.center;
+                double rr = ( start.ball.center - node.ball.center ).length();
+                if( rr > radius ){ radius = rr; }
+                bb.nodes.push_back( nid );
+            }
+            bb.ball.center = centroid / b.nodes.size();
+            bb.ball.radius = radius;
         }
         
+        // needs the balls of the incident bones
+        void fitJointBall( NodeID id ){
+            const SkelNode& n = nodes[id];
+            assert( n.type == SNT_Junction );
+            BranchingBall&  jb = cd_hierarchy->joints[n.ID];
+            jb.ID = n.ID;
+            jb.incidentBones.clear();
+            double radius = 0;
+            for( NodeID neighbor : n.neighbors ){
+                BoneID neighbor_bone_id = nodes[neighbor].boneID;
+                jb.incidentBones.push_back( neighbor_bone_id );
+                double rr = ( cd_hierarchy->bones[neighbor_bone_id].ball.center - n.ball.center ).length();
+                if( rr > radius ){ radius = rr; }
+            }
+            jb.ball.radius = radius;
+        }
         
         void buildCollisionDetectionHierarchy(){
+            delete this->cd_hierarchy;
             this->cd_hierarchy = new ShapeBall();
             cd_hierarchy->ball = bounding_sphere;
             
             // build bones ball
-            for( const SkelBone& b : bones ){
-                double      radius = ( nodes.at( b.nodes.front( )).ball.center - nodes.at( b.nodes.back( )).ball.center ).length() ;
-                CGLA::Vec3d centroid( 0.0 );
-                const SkelNode& start = nodes[b.nodes.front()];
-                cd_hierarchy->bones[b.ID];
-                assert(cd_hierarchy->bones.count( b.ID ));
-                cd_hierarchy->bones[b.ID].ID = b.ID;
-
-                for( NodeID nid : b.nodes ){
-                    const SkelNode& node = nodes[nid];
-                    centroid += node.ball.center;
-                    double rr = ( start.ball.center - node.ball.center ).length();
-                    if( rr > radius ){ radius = rr; }
-                    cd_hierarchy->bones[b.ID].nodes.push_back( nid );
-                }
-                cd_hierarchy->bones[b.ID].ball.center = centroid / b.nodes.size();
-                cd_hierarchy->bones[b.ID].ball.radius = radius;
-            }
+            for( const SkelBone& b : bones ){ fitBoneBall( b.ID ); }
             
             // build joints ball
             //      get bone IDs
             for( const SkelNode& n : nodes ){
-                if( n.isBranching() ){
-                    assert( n.type == SNT_Junction );
-                    cd_hierarchy->joints[n.ID];
-                    cd_hierarchy->joints[n.ID].ID = n.ID;
-                    assert( cd_hierarchy->joints.count(n.ID) > 0 );
-                    double radius = 0;
-                    for( NodeID neighbor : n.neighbors ){
-                        BoneID neighbor_bone_id = nodes[neighbor].boneID;
-                        cd_hierarchy->joints[n.ID].incidentBones.push_back( neighbor_bone_id );
-                        double rr = ( cd_hierarchy->bones[neighbor_bone_id].ball.center - n.ball.center ).length();
-                        if( rr > radius ){ radius = rr; }
-                    }
-                    cd_hierarchy->joints[n.ID].ball.radius = radius;
-                }
+                if( n.isBranching() ){ fitJointBall( n.ID ); }
             }
+            
+            bvh.build( nodes );
         }
         
         public :
@@ -269,7 +479,8 @@ namespace Procedural{
         std::vector< SkelBone > bones;
         std::map< HMesh::VertexID, NodeID> poleToNode;
         std::map< HMesh::VertexID, NodeID> junctionSingularityToNode;
-        ShapeBall* cd_hierarchy;
+        ShapeBall* cd_hierarchy = NULL;
+        BallTree   bvh;
         Ball       bounding_sphere;
         bool valid = false;
         
@@ -549,25 +760,26 @@ namespace Procedural{
             s.saveToFile("//Users//francescousai//Desktop//cd.skel");
         }
         
-        void copyAndRealignIDs( const Skeleton &other, const HMesh::VertexIDRemap& vremap ){
+        void copyAndRealignIDs( const Skeleton &other, const VertexIDTable& vtable ){
             copyNew( other );
-            reAlignIDs( vremap );
+            reAlignIDs( vtable );
         }
         
-        void reAlignIDs( const HMesh::VertexIDRemap& vremap ){
+        // only the pole keys change, nodes, bones and the collision hierarchy are untouched
+        void reAlignIDs( const VertexIDTable& vtable ){
 
-            std::map< HMesh::VertexID, NodeID> remapped;
+            std::map< HMesh::VertexID, NodeID> realigned;
             for( auto item : poleToNode ){
-                assert(vremap.count( item.first ) > 0 );
-                remapped[ vremap.at( item.first )] = item.second;
+                realigned[ remapped( vtable, item.first )] = item.second;
             }
-            poleToNode = std::move( remapped );
+            poleToNode = std::move( realigned );
         }
         
         void transform( const CGLA::Mat4x4d& T ){
             for( int i = 0; i < nodes.size(); ++i ){
                 nodes[i].transform( T );
             }
+            bvh.transform( T );
         }
         
         void copyNew( const Skeleton &other ){
@@ -596,6 +808,7 @@ namespace Procedural{
             }
             
             // collision detection hierarchy
+            delete cd_hierarchy;
             cd_hierarchy = new ShapeBall();
             cd_hierarchy->ball.center = other.cd_hierarchy->ball.center;
             cd_hierarchy->ball.radius = other.cd_hierarchy->ball.radius;
@@ -620,6 +833,7 @@ namespace Procedural{
                     cd_hierarchy->bones[item.first].nodes.push_back( nid );
                 }
             }
+            bvh = other.bvh;
         }
         
         // ther is copied by value
@@ -638,6 +852,7 @@ namespace Procedural{
             // add to this skeleton all other nodes except those involved in glueing
             // shifting their ID
             NodeID current_node_id = nodes.size() - 1;
+            NodeID first_new_node  = nodes.size();
             std::map< NodeID, NodeID > new_node_IDs;
             
             // copy the non-involved nodes
@@ -654,7 +869,7 @@ namespace Procedural{
                 new_node_IDs[node.ID] = new_node.ID;
             }
             
-            std::vector< BoneID > other_bones_glued;
+            std::vector< BoneID > other_bones_glued, this_bones_extended;
             
             // merge the glued poles and reopen their bones
             for( int i = 0; i< this_pole_nodes.size(); ++i ){
@@ -703,8 +918,10 @@ namespace Procedural{
                     closeBone( curr_bone, back );
                 }
                 other_bones_glued.push_back( other_curr_bone );
+                this_bones_extended.push_back( curr_bone );
             }
             
+            BoneID first_new_bone = bones.size();
             for( const SkelBone& b : other.bones ){
                 if( std::find( other_bones_glued.begin(), other_bones_glued.end(), b.ID ) != other_bones_glued.end()) { continue; }
                 openBone( new_node_IDs[b.nodes.front()] );
@@ -721,7 +938,7 @@ namespace Procedural{
             }
             
             assert( sanityCheck( ));
-            mergeCollisionDetectionHierarchy();
+            mergeCollisionDetectionHierarchy( first_new_node, first_new_bone, this_bones_extended, this_pole_nodes );
         }
     };
 }
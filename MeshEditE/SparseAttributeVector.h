@@ -0,0 +1,86 @@
+//
+//  SparseAttributeVector.h
+//  MeshEditE
+//
+
+#ifndef __MeshEditE__SparseAttributeVector__
+#define __MeshEditE__SparseAttributeVector__
+
+#include <vector>
+#include <utility>
+#include <GEL/HMesh/Manifold.h>
+
+/** Same use as an HMesh::AttributeVector, for attributes that only live on a small part of a large
+ mesh. Open addressing with linear probing, so the memory and the cost of creating and clearing
+ it are proportional to the number of items that were written, not to the size of the mesh.
+ Items that were never written read as the default value. */
+template<typename ITEMID, typename T>
+class SparseAttributeVector {
+public:
+    SparseAttributeVector(const T& _default_value = T(), size_t expected_size = 32):
+    default_value(_default_value), no_items(0)
+    {
+        size_t capacity = 16;
+        while(capacity < 2 * expected_size) capacity *= 2;
+        slots.assign(capacity, std::make_pair(EMPTY, default_value));
+    }
+    
+    /// read only access, does not insert
+    const T& operator[](ITEMID id) const {
+        size_t i = find(id.get_index());
+        return slots[i].first == EMPTY ? default_value : slots[i].second;
+    }
+    
+    /// inserts the default value if the item is not there
+    T& operator[](ITEMID id) {
+        size_t key = id.get_index();
+        size_t i = find(key);
+        if(slots[i].first == EMPTY) {
+            if(2 * (no_items + 1) > slots.size()) {
+                grow();
+                i = find(key);
+            }
+            slots[i].first = key;
+            ++no_items;
+        }
+        return slots[i].second;
+    }
+    
+    bool contains(ITEMID id) const { return slots[find(id.get_index())].first != EMPTY; }
+    size_t size() const { return no_items; }
+    
+    void clear() {
+        for(auto& s : slots) s = std::make_pair(EMPTY, default_value);
+        no_items = 0;
+    }
+    
+private:
+    static const size_t EMPTY = static_cast<size_t>(-1);
+    
+    size_t find(size_t key) const {
+        size_t mask = slots.size() - 1;
+        size_t i = (key * 0x9E3779B97F4A7C15ull) & mask;
+        while(slots[i].first != EMPTY && slots[i].first != key)
+            i = (i + 1) & mask;
+        return i;
+    }
+    
+    void grow() {
+        std::vector<std::pair<size_t, T>> old(2 * slots.size(), std::make_pair(EMPTY, default_value));
+        swap(old, slots);
+        for(auto& s : old)
+            if(s.first != EMPTY)
+                slots[find(s.first)] = s;
+    }
+    
+    T                                   default_value;
+    size_t                              no_items;
+    std::vector<std::pair<size_t, T>>   slots;
+};
+
+template<typename T>
+using SparseVertexAttributeVector = SparseAttributeVector<HMesh::VertexID, T>;
+template<typename T>
+using SparseFaceAttributeVector = SparseAttributeVector<HMesh::FaceID, T>;
+
+#endif /* defined(__MeshEditE__SparseAttributeVector__) */
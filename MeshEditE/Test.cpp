@@ -7,7 +7,6 @@
 //
 
 #include "Test.h"
-#include <GEL/GLGraphics/MeshEditor.h>
 #include <GEL/CGLA/Vec3d.h>
 #include <GEL/HMesh/obj_save.h>
 #include <GEL/CGLA/Mat3x3d.h>
@@ -21,11 +20,10 @@
 #include "Procedural/Helpers/Plane.h"
 #include <MeshEditE/Procedural/Operations/geometric_operations.h>
 #include <MeshEditE/Procedural/Helpers/geometric_properties.h>
-#include <MesheditE/Procedural/Helpers/structural_helpers.h>
+#include <MeshEditE/Procedural/Helpers/structural_helpers.h>
 #include "patch_mapping.h"
 
 
-using namespace GLGraphics;
 using namespace std;
 using namespace CGLA;
 using namespace HMesh;
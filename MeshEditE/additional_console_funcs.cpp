@@ -18,12 +18,15 @@
 #include <regex>
 #include <set>
 #include <queue>
+#include <memory>
 #include "additional_console_funcs.h"
 #include <GEL/GLGraphics/MeshEditor.h>
 
 #include "LogMap.h"
 #include "polarize.h"
 #include "heat_kernel_laplacian.h"
+#include "HMeshParallelKit.h"
+#include "ManifoldCSR.h"
 
 using namespace std;
 using namespace CGLA;
@@ -1148,8 +1151,16 @@ void console_make_harmonic(MeshEditor* me, const std::vector<std::string> & args
             nailed[v] = 1;
         harmonic[v] = harmonic_extrema[v];
     }
+    // the solver is kept as long as the mesh and the nailed vertices stay the same
+    static unique_ptr<HarmonicSolver> solver;
+    if(!solver || !solver->matches(me->active_mesh(), nailed))
+        solver.reset(new HarmonicSolver(me->active_mesh(), nailed));
+    int iter = solver->solve(harmonic);
+    if(iter < 0)
+        me->printf("harmonic solver did not converge");
+    // smooth_fun used to end with 5 steps that also move the nailed vertices
     smooth_fun(me->active_mesh(), nailed,
-               harmonic, 10000);
+               harmonic, 5);
     
     if (doshift) {
         for(VertexID v: me->active_mesh().vertices())
@@ -1217,13 +1228,17 @@ void console_laplacian_flatten(MeshEditor* me, const std::vector<std::string> &
     }
     me->save_active_mesh();
     Manifold& m = me->active_mesh();
-    auto laplacian = [&](VertexID v)
+    ManifoldCSR csr(m);
+    vector<Vec3d> pos, new_pos;
+    csr.gather_positions(m, pos);
+    new_pos.resize(pos.size());
+    auto laplacian = [&](size_t v)
     {
         Vec3d p(0);
-        int n = circulate_vertex_ccw(m, v, (std::function<void(VertexID)>)[&](VertexID v){ p += m.pos(v); });
-        return p / n - m.pos(v);
+        for(int s = csr.offsets[v]; s < csr.offsets[v+1]; ++s)
+            p += pos[csr.neighbors[s]];
+        return p / double(csr.offsets[v+1] - csr.offsets[v]) - pos[v];
     };
-    VertexAttributeVector<Vec3d> new_pos = m.positions_attribute_vector();
     static VertexAttributeVector<Vec3d> pdir;
     static bool was_here = false;
     if(!was_here) {
@@ -1239,16 +1254,17 @@ void console_laplacian_flatten(MeshEditor* me, const std::vector<std::string> &
     //    auto normal_field_t = h.analyze_signal(normal_field);
     //    pdir = h.reconstruct_signal(normal_field_t,2);
     
+    vector<Vec3d> dirs;
+    csr.gather(pdir, dirs);
     for(int i=0;i<iter;++i) {
-        for(VertexID v: m.vertices())
+        parallel_for(size_t(0), csr.no_vertices(), [&](size_t v)
         {
-            Vec3d dir = pdir[v];//normalize(global_dir - pdir[v]*dot(global_dir, pdir[v]));
-            new_pos[v] = m.pos(v) + 0.5 * dir*dot(dir,laplacian(v));
-            Vec3d n = normal(m, v);
-            
-        }
-        m.positions_attribute_vector() = new_pos;
+            Vec3d dir = dirs[v];//normalize(global_dir - pdir[v]*dot(global_dir, pdir[v]));
+            new_pos[v] = pos[v] + 0.5 * dir*dot(dir,laplacian(v));
+        });
+        swap(pos, new_pos);
     }
+    csr.scatter_positions(pos, m);
     for(VertexID v: m.vertices())
         me->active_visobj().get_scalar_field_attrib_vector()[v] = dot(normal(m,v),pdir[v]);
     HMesh::VertexAttributeVector<int> nailed(m.no_vertices(),0);
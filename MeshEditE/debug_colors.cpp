@@ -0,0 +1,34 @@
+//
+//  debug_colors.cpp
+//  MeshEditE
+//
+//  GUI implementation of debug_colors.h, the colors are shown by the DebugRenderer and the
+//  texture coordinates by the CheckerBoardRenderer.
+//
+
+#include "debug_colors.h"
+#include <GEL/GLGraphics/ManifoldRenderer.h>
+
+using namespace CGLA;
+using namespace HMesh;
+using namespace GLGraphics;
+
+Vec3f& debug_vertex_color ( VertexID v )
+{
+    return DebugRenderer::vertex_colors[v];
+}
+
+Vec3f& debug_edge_color ( HalfEdgeID h )
+{
+    return DebugRenderer::edge_colors[h];
+}
+
+Vec3f& debug_face_color ( FaceID f )
+{
+    return DebugRenderer::face_colors[f];
+}
+
+Vec2f& debug_vertex_uv ( VertexID v )
+{
+    return CheckerBoardRenderer::param[v];
+}
@@ -0,0 +1,22 @@
+//
+//  debug_colors.h
+//  MeshEditE
+//
+//  Per element debug colors and checkerboard texture coordinates. The GUI build forwards them to GLGraphics::DebugRenderer
+//  (debug_colors.cpp), the headless tools link Headless/debug_colors_headless.cpp instead
+//  so that the algorithms do not depend on GL.
+//
+
+#ifndef __MeshEditE__debug_colors__
+#define __MeshEditE__debug_colors__
+
+#include <GEL/CGLA/Vec2f.h>
+#include <GEL/CGLA/Vec3f.h>
+#include <GEL/HMesh/Manifold.h>
+
+CGLA::Vec3f& debug_vertex_color ( HMesh::VertexID v );
+CGLA::Vec3f& debug_edge_color   ( HMesh::HalfEdgeID h );
+CGLA::Vec3f& debug_face_color   ( HMesh::FaceID f );
+CGLA::Vec2f& debug_vertex_uv    ( HMesh::VertexID v );
+
+#endif /* defined(__MeshEditE__debug_colors__) */
@@ -8,62 +8,115 @@
 
 #include "LogMap.h"
 #include "heat_kernel_laplacian.h"
-#include <GEL/GLGraphics/ManifoldRenderer.h>
-#include <GEL/LinAlg/LapackFunc.h>
+#include "HMeshParallelKit.h"
 
 using namespace CGLA;
 using namespace HMesh;
 using namespace Geometry;
-using namespace GLGraphics;
-using namespace LinAlg;
 using namespace std;
 
-VertexAttributeVector<double> heat_kernel_laplacian(Manifold& m, double R) {
-    double avg_len = 0;
-    for(auto h : m.halfedges())
-        avg_len += length(m,h);
-    avg_len /= m.no_halfedges();
-    R *= avg_len;
+namespace {
+    /// solves A x = b for the symmetric positive definite 5x5 A with an LDL^T factorization,
+    /// b has three columns. Returns false if A is ( numerically ) singular.
+    bool solve_5x5_LDLT(double A[5][5], double b[5][3], double x[5][3])
+    {
+        double L[5][5] = {{0}}, D[5];
+        double scale = 0;
+        for(int i=0;i<5;++i)
+            scale = max(scale, A[i][i]);
+        for(int j=0;j<5;++j) {
+            double d = A[j][j];
+            for(int k=0;k<j;++k)
+                d -= sqr(L[j][k]) * D[k];
+            if(d <= 1e-12 * scale)
+                return false;
+            D[j] = d;
+            L[j][j] = 1;
+            for(int i=j+1;i<5;++i) {
+                double l = A[i][j];
+                for(int k=0;k<j;++k)
+                    l -= L[i][k] * L[j][k] * D[k];
+                L[i][j] = l / d;
+            }
+        }
+        for(int c=0;c<3;++c) {
+            double y[5];
+            for(int i=0;i<5;++i) {
+                y[i] = b[i][c];
+                for(int k=0;k<i;++k)
+                    y[i] -= L[i][k] * y[k];
+            }
+            for(int i=4;i>=0;--i) {
+                x[i][c] = y[i] / D[i];
+                for(int k=i+1;k<5;++k)
+                    x[i][c] -= L[k][i] * x[k][c];
+            }
+        }
+        return true;
+    }
     
-    int cnt = 0;
-    double avg = 0;
-    VertexAttributeVector<double> mc(m.allocated_vertices(), 0);
-    for(VertexID v: m.vertices()) {
+    /// fits a quadratic height function to the log map of v. The Laplacian is the sum of the two
+    /// second order coefficients, i.e. rows 2 and 4 of (U^T U)^-1 U^T P where P are the offsets
+    /// from v. U^T U and U^T P are accumulated directly, so nothing is allocated per point.
+    double heat_kernel_mean_curvature(Manifold& m, VertexID v, double R)
+    {
         FaceID f = m.walker(v).face();
         Vec3f b = barycentric_coords(m, m.pos(v), f);
         LogMap log_map(m, ManiPoint(f,b), R);
         auto pts = log_map.enumerate();
-        int N = pts.size();
         
-        vector<double> weight_vec(N);   
-        CMatrix U(N,5);
-        for(int i=0;i<N;++i)
+        double UTU[5][5] = {{0}};
+        double UTP[5][3] = {{0}};
+        Vec3d p03d = m.pos(v);
+        for(const auto& pt : pts)
         {
-            Vec2f uv = pts[i].second;
-            U[i][0] = uv[0];
-            U[i][1] = uv[1];
-            U[i][2] = 0.5*sqr(uv[0]);
-            U[i][3] = uv[0]*uv[1];
-            U[i][4] = 0.5*sqr(uv[1]);
+            Vec2f uv = pt.second;
+            double u[5] = { uv[0], uv[1], 0.5*sqr(uv[0]), uv[0]*uv[1], 0.5*sqr(uv[1]) };
+            Vec3d d = pt.first - p03d;
+            for(int i=0;i<5;++i) {
+                for(int j=0;j<=i;++j)
+                    UTU[i][j] += u[i] * u[j];
+                for(int c=0;c<3;++c)
+                    UTP[i][c] += u[i] * d[c];
+            }
         }
+        for(int i=0;i<5;++i)
+            for(int j=i+1;j<5;++j)
+                UTU[i][j] = UTU[j][i];
         
-        CMatrix UT = U.Transposed();
-        CMatrix D = Inverted(UT * U)*UT;
-        for(int i=0;i<N;++i)
-            weight_vec[i] = D[2][i] + D[4][i];
+        double X[5][3];
+        if(!solve_5x5_LDLT(UTU, UTP, X))
+            return 0;
+        Vec3d L(X[2][0] + X[4][0], X[2][1] + X[4][1], X[2][2] + X[4][2]);
+        return - 0.5 * L.length() * sign(dot(L,normal(m,v)));
+    }
+}
 
-        
-        Vec3d p03d = m.pos(v);
-        Vec3d L(0);
-        for(int i=0;i<N;++i) {
-            Vec3d p3d = pts[i].first;
-            L += weight_vec[i] * (p3d-p03d);
-        }
-        mc[v] = - 0.5 * L.length() * sign(dot(L,normal(m,v)));
+VertexAttributeVector<double> heat_kernel_laplacian(Manifold& m, double R) {
+    return heat_kernel_laplacian(m, vertex_ids(m), R);
+}
+
+VertexAttributeVector<double> heat_kernel_laplacian(Manifold& m, const vector<VertexID>& vertices, double R) {
+    VertexAttributeVector<double> mc(m.allocated_vertices(), 0);
+    if(vertices.empty())
+        return mc;
+    
+    double avg_len = 0;
+    for(auto h : m.halfedges())
+        avg_len += length(m,h);
+    avg_len /= m.no_halfedges();
+    R *= avg_len;
+    
+    parallel_for(vertices, [&](VertexID v) {
+        mc[v] = heat_kernel_mean_curvature(m, v, R);
+    });
+    
+#ifdef TRACE
+    double avg = 0;
+    for(VertexID v: vertices)
         avg += mc[v];
-        ++cnt;
-    }
-    cout << "Average mean curvature : " << avg/cnt << endl;
+    cout << "Average mean curvature : " << avg/vertices.size() << endl;
+#endif
     return mc;
 }
 
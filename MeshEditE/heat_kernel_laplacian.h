@@ -10,9 +10,13 @@
 #define __MeshEditE__heat_kernel_laplacian__
 
 #include <iostream>
+#include <vector>
 #include <GEL/HMesh/Manifold.h>
 
 HMesh::VertexAttributeVector<double> heat_kernel_laplacian(HMesh::Manifold& m, double R = 2.0);
+/// only for the given vertices ( e.g. the ones near the poles ), the others get 0
+HMesh::VertexAttributeVector<double> heat_kernel_laplacian(HMesh::Manifold& m, const std::vector<HMesh::VertexID>& vertices,
+                                                           double R = 2.0);
 
 
 #endif /* defined(__MeshEditE__heat_kernel_laplacian__) */
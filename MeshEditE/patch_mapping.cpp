@@ -9,14 +9,13 @@
 #include "patch_mapping.h"
 #include "polarize.h"
 #include <MeshEditE/Procedural/Helpers/geometric_properties.h>
-#include <GEL/GLGraphics/ManifoldRenderer.h>
+#include "debug_colors.h"
 #include <queue>
 #include <unordered_set>
 
 using namespace HMesh;
 using namespace std;
 using namespace Procedural::Geometry;
-using namespace GLGraphics;
 using namespace CGLA;
 
 
@@ -106,17 +105,17 @@ void build_patches( Manifold& m, FaceAttributeVector<int> &face_to_patch )
     for( auto heid : m.halfedges() )
     {
         if( is_layout[heid])
-            DebugRenderer::edge_colors[heid] = Vec3f( 0.0, 0.0, 1.0);
+            debug_edge_color( heid ) = Vec3f( 0.0, 0.0, 1.0);
         else
-            DebugRenderer::edge_colors[heid] = Vec3f( 0.0, 0.0, 0.0);
+            debug_edge_color( heid ) = Vec3f( 0.0, 0.0, 0.0);
     }
 //    for( FaceID fid : m.faces() )
 //    {
-//        DebugRenderer::face_colors[fid] = Vec3f( 0.0, 0.0, 0.0);
+//        debug_face_color( fid ) = Vec3f( 0.0, 0.0, 0.0);
 //    }
     for( VertexID c : corners )
     {
-        DebugRenderer::vertex_colors[c] = Vec3f( 1.0, 1.0, 1.0 );
+        debug_vertex_color( c ) = Vec3f( 1.0, 1.0, 1.0 );
     }
 
     int current_patch = 1;
@@ -146,14 +145,14 @@ void build_patches( Manifold& m, FaceAttributeVector<int> &face_to_patch )
             {
                 cout << "last vertex was corner?" << last_vertex_was_corner << endl;
                 assert(is_layout[hew.halfedge()] == 1);
-                DebugRenderer::edge_colors[hew.halfedge()] = Vec3f( 1.0, 0.0, 0.0);
+                debug_edge_color( hew.halfedge() ) = Vec3f( 1.0, 0.0, 0.0);
                 face_to_patch[ hew.face() ] = current_patch;
                 done = hew.vertex() == C;
                 // follow until a corner is reached
                 if( is_corner( hew.vertex(), corners ))
 //                if( is_corner( m, hew.vertex(), is_layout ))
                 {
-                    DebugRenderer::vertex_colors[hew.vertex()] = Vec3f( 0.0, 1.0, 0.0);
+                    debug_vertex_color( hew.vertex() ) = Vec3f( 0.0, 1.0, 0.0);
                     // turn left
                     hew = hew.next();
                     // mark outgoing edge as visited
@@ -252,7 +251,7 @@ void build_patches( Manifold& m, FaceAttributeVector<int> &face_to_patch )
     for( FaceID fid : m.faces() )
     {
 //        if( face_to_patch[fid] != -1 )
-        DebugRenderer::face_colors[fid] = get_color(face_to_patch[fid]);
+        debug_face_color( fid ) = get_color(face_to_patch[fid]);
         patches.insert( face_to_patch[fid] );
     }
 
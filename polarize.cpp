@@ -34,13 +34,13 @@
 #include <GEL/Geometry/build_bbtree.h>
 #include <GEL/Geometry/RGrid.h>
 #include <GEL/Geometry/TrilinFilter.h>
-#include <GEL/GLGraphics/ManifoldRenderer.h>
+#include "debug_colors.h"
 
 #include <GEL/LinAlg/LapackFunc.h>
 
 #include "LogMap.h"
 #include "HMeshParallelKit.h"
-#include <GEL/GLGraphics/MeshEditor.h>
+#include "ManifoldCSR.h"
 #include "polarize.h"
 
 using namespace CGLA;
@@ -48,7 +48,6 @@ using namespace Geometry;
 using namespace std;
 using namespace HMesh;
 using namespace LinAlg;
-using namespace GLGraphics;
 
 bool is_pole( Manifold& m, VertexID v)
 {
@@ -154,38 +153,44 @@ void smooth_fun(const Manifold& m,
                 const VertexAttributeVector<int>& nailed,
                 VertexAttributeVector<T>& fun, int iter)
 {
-    auto batches = batch_vertices(m);
+    // the topology does not change, the iterations run on a CSR copy of it
+    ManifoldCSR csr(m);
     HalfEdgeAttributeVector<double> edge_weights;
     FaceAttributeVector<int> included(m.allocated_faces(),1);
     compute_edge_weights(m,edge_weights, included);
+    vector<double> weights;
+    csr.gather_slots(edge_weights, weights);
+    vector<int> is_nailed;
+    csr.gather(nailed, is_nailed);
+    vector<T> cur, next;
+    csr.gather(fun, cur);
+    next = cur;
+    
     bool ignore_nailing = false;
-    auto new_fun = fun;
-    auto f = [&](const vector<VertexID>& vids) {
-        for(VertexID v: vids)
-            if(!nailed[v] || ignore_nailing)
-            {
-                double w_sum = 0;
-                new_fun[v] = T(0);
-                circulate_vertex_ccw(m, v, [&](Walker wv) {
-                    double w = edge_weights[wv.halfedge()];
-                    new_fun[v] += w * fun[wv.vertex()];
-                    w_sum += w;
-                });
-                new_fun[v] /= w_sum;
-                new_fun[v] = 0.5 * new_fun[v] + 0.5 * fun[v];
+    auto f = [&](size_t v) {
+        if(!is_nailed[v] || ignore_nailing)
+        {
+            double w_sum = 0;
+            T sum(0);
+            for(int s = csr.offsets[v]; s < csr.offsets[v+1]; ++s) {
+                sum += weights[s] * cur[csr.neighbors[s]];
+                w_sum += weights[s];
             }
+            next[v] = 0.5 * (sum / w_sum) + 0.5 * cur[v];
+        }
     };
     for(int i = 0; i < iter-5; ++i)
     {
-        for_each_vertex_parallel(CORES, batches, f);
-        swap(fun,new_fun);
+        parallel_for(size_t(0), csr.no_vertices(), f);
+        swap(cur,next);
     }
     ignore_nailing = true;
     
     for(int i = 0; i < 5; ++i) {
-        for_each_vertex_parallel(CORES, batches, f);
-        swap(fun,new_fun);
+        parallel_for(size_t(0), csr.no_vertices(), f);
+        swap(cur,next);
     }
+    csr.scatter(cur, fun);
 }
 
 template void smooth_fun<double>(const Manifold& m,
@@ -195,6 +200,148 @@ template void smooth_fun<Vec3d>(const Manifold& m,
                                  const VertexAttributeVector<int>& nailed,
                                  VertexAttributeVector<Vec3d>& fun, int iter);
 
+HarmonicSolver::HarmonicSolver(const Manifold& m, const VertexAttributeVector<int>& nailed)
+{
+    ManifoldCSR csr(m);
+    HalfEdgeAttributeVector<double> edge_weights;
+    FaceAttributeVector<int> included(m.allocated_faces(),1);
+    compute_edge_weights(m,edge_weights, included);
+    vector<double> weights;
+    csr.gather_slots(edge_weights, weights);
+    
+    all_ids = csr.vertex_id;
+    csr.gather_positions(m, positions);
+    csr.gather(nailed, is_nailed);
+    no_halfedges = m.no_halfedges();
+    ring_offsets = csr.offsets;
+    ring_ids.resize(csr.no_slots());
+    for(size_t s = 0; s < csr.no_slots(); ++s)
+        ring_ids[s] = csr.vertex_id[csr.neighbors[s]];
+    
+    vector<int> unknown(csr.no_vertices(), -1);
+    for(size_t v = 0; v < csr.no_vertices(); ++v)
+        if(!is_nailed[v]) {
+            unknown[v] = static_cast<int>(free_ids.size());
+            free_ids.push_back(csr.vertex_id[v]);
+        }
+    
+    W_offsets.push_back(0);
+    B_offsets.push_back(0);
+    for(size_t v = 0; v < csr.no_vertices(); ++v)
+        if(!is_nailed[v]) {
+            double w_sum = 0;
+            for(int s = csr.offsets[v]; s < csr.offsets[v+1]; ++s)
+                w_sum += weights[s];
+            for(int s = csr.offsets[v]; s < csr.offsets[v+1]; ++s) {
+                int n = csr.neighbors[s];
+                if(is_nailed[n]) {
+                    B_cols.push_back(csr.vertex_id[n]);
+                    B_vals.push_back(weights[s] / w_sum);
+                }
+                else {
+                    W_cols.push_back(unknown[n]);
+                    W_vals.push_back(weights[s] / w_sum);
+                }
+            }
+            W_offsets.push_back(static_cast<int>(W_cols.size()));
+            B_offsets.push_back(static_cast<int>(B_cols.size()));
+        }
+}
+
+bool HarmonicSolver::matches(const Manifold& m, const VertexAttributeVector<int>& nailed) const
+{
+    if(m.no_vertices() != all_ids.size() || m.no_halfedges() != no_halfedges)
+        return false;
+    for(size_t v = 0; v < all_ids.size(); ++v) {
+        if(!m.in_use(all_ids[v]) || m.pos(all_ids[v]) != positions[v] || (nailed[all_ids[v]] != 0) != (is_nailed[v] != 0))
+            return false;
+        // same neighbors in the same order, e.g. an edge flip changes the rings of four vertices
+        int s = ring_offsets[v];
+        for(Walker w = m.walker(all_ids[v]); !w.full_circle(); w = w.circulate_vertex_ccw(), ++s)
+            if(s == ring_offsets[v+1] || w.vertex() != ring_ids[s])
+                return false;
+        if(s != ring_offsets[v+1])
+            return false;
+    }
+    return true;
+}
+
+int HarmonicSolver::solve(VertexAttributeVector<double>& fun, double tolerance, int max_iter)
+{
+    size_t N = free_ids.size();
+    if(x.size() != N) {
+        x.resize(N);
+        for(size_t i = 0; i < N; ++i)
+            x[i] = fun[free_ids[i]];
+    }
+    
+    auto mul = [&](const vector<double>& in, vector<double>& out) {
+        parallel_for(size_t(0), N, [&](size_t i) {
+            double y = in[i];
+            for(int k = W_offsets[i]; k < W_offsets[i+1]; ++k)
+                y -= W_vals[k] * in[W_cols[k]];
+            out[i] = y;
+        });
+    };
+    auto dot = [&](const vector<double>& a, const vector<double>& b) {
+        double d = 0;
+        for(size_t i = 0; i < N; ++i)
+            d += a[i] * b[i];
+        return d;
+    };
+    
+    vector<double> b(N), r(N), r0(N), p(N, 0.0), v(N, 0.0), s(N), t(N);
+    for(size_t i = 0; i < N; ++i) {
+        b[i] = 0;
+        for(int k = B_offsets[i]; k < B_offsets[i+1]; ++k)
+            b[i] += B_vals[k] * fun[B_cols[k]];
+    }
+    mul(x, r);
+    for(size_t i = 0; i < N; ++i)
+        r[i] = b[i] - r[i];
+    r0 = r;
+    
+    double b_norm = sqrt(dot(b,b));
+    double threshold = tolerance * (b_norm > 0 ? b_norm : 1.0);
+    double rho = 1, alpha = 1, omega = 1;
+    int iter = 0;
+    bool converged = sqrt(dot(r,r)) <= threshold;
+    for(; !converged && iter < max_iter; ++iter)
+    {
+        double rho_new = dot(r0, r);
+        if(rho_new == 0) break;
+        double beta = (rho_new / rho) * (alpha / omega);
+        rho = rho_new;
+        for(size_t i = 0; i < N; ++i)
+            p[i] = r[i] + beta * (p[i] - omega * v[i]);
+        mul(p, v);
+        alpha = rho / dot(r0, v);
+        for(size_t i = 0; i < N; ++i)
+            s[i] = r[i] - alpha * v[i];
+        if(sqrt(dot(s,s)) <= threshold) {
+            for(size_t i = 0; i < N; ++i)
+                x[i] += alpha * p[i];
+            converged = true;
+            ++iter;
+            break;
+        }
+        mul(s, t);
+        double tt = dot(t,t);
+        if(tt == 0) break;
+        omega = dot(t, s) / tt;
+        for(size_t i = 0; i < N; ++i) {
+            x[i] += alpha * p[i] + omega * s[i];
+            r[i] = s[i] - omega * t[i];
+        }
+        converged = sqrt(dot(r,r)) <= threshold;
+        if(omega == 0) break;
+    }
+    
+    for(size_t i = 0; i < N; ++i)
+        fun[free_ids[i]] = x[i];
+    return converged ? iter : -1;
+}
+
 void shortest_edge_triangulate_face(Manifold& m, FaceID f0, const VertexAttributeVector<int>& ls_id)
 {
     queue<FaceID> face_queue;
@@ -1227,8 +1374,8 @@ void polar_segment(Manifold& m, bool show_segments)
             if (show_segments)
                 col = 0.9*get_color(face_segment[m.walker(hid).face()]);
             else col = Vec3f(0.8,0,0);
-            if(DebugRenderer::edge_colors[hid] != Vec3f(0,1,0))
-                DebugRenderer::edge_colors[hid] = col;
+            if(debug_edge_color( hid ) != Vec3f(0,1,0))
+                debug_edge_color( hid ) = col;
         }
         else {
             const Vec3f col_normal(0,0,0.6);
@@ -1237,23 +1384,23 @@ void polar_segment(Manifold& m, bool show_segments)
             Walker w = m.walker(hid);
             if (show_segments && edge_info[hid].edge_type != RIB_JUNCTION)
                 col = 0.9 * get_color(face_segment[w.face()]);
-            if(DebugRenderer::edge_colors[w.halfedge()] != Vec3f(0,1,0)) {
-                DebugRenderer::edge_colors[w.halfedge()] = col;
-                DebugRenderer::edge_colors[w.opp().halfedge()] = col;
+            if(debug_edge_color( w.halfedge() ) != Vec3f(0,1,0)) {
+                debug_edge_color( w.halfedge() ) = col;
+                debug_edge_color( w.opp().halfedge() ) = col;
             }
-            DebugRenderer::vertex_colors[w.vertex()] = col;
-            DebugRenderer::vertex_colors[w.opp().vertex()] = col;
+            debug_vertex_color( w.vertex() ) = col;
+            debug_vertex_color( w.opp().vertex() ) = col;
         }
         
     }
     for(FaceID fid : m.faces()) {
         Vec3f col(1);
         if (show_segments) col = get_color(face_segment[fid]);
-        DebugRenderer::face_colors[fid] = col;
+        debug_face_color( fid ) = col;
     }
     for(VertexID vid : m.vertices())
         if(is_pole(m, vid))
-            DebugRenderer::vertex_colors[vid] = Vec3f(0.6,0,0);
+            debug_vertex_color( vid ) = Vec3f(0.6,0,0);
 }
 
 
@@ -1272,9 +1419,9 @@ void show_skin(Manifold& m, int j)
     for(VertexID v: m.vertices())
     {
         if(skinning[v][j]>0)
-            DebugRenderer::vertex_colors[v] = Vec3f(1,0,0) * skinning[v][j];
+            debug_vertex_color( v ) = Vec3f(1,0,0) * skinning[v][j];
         else
-            DebugRenderer::vertex_colors[v] = Vec3f(0,0,0.3);
+            debug_vertex_color( v ) = Vec3f(0,0,0.3);
     }
 }
 
@@ -1492,14 +1639,14 @@ void skeleton_retract(Manifold& m, double frac, VertexID v)
             VertexID v = w.vertex();
             int id = edge_info[h].id;
             if(id == 1)
-                DebugRenderer::vertex_colors[v] = Vec3f(1,0.7,.7);
+                debug_vertex_color( v ) = Vec3f(1,0.7,.7);
             else if(skel_nodes[id].in_use)
-                DebugRenderer::vertex_colors[v] = Vec3f(1);
+                debug_vertex_color( v ) = Vec3f(1);
             else
-                DebugRenderer::vertex_colors[v] = Vec3f(0);
-            DebugRenderer::face_colors[w.face()] = Vec3f(0.3);
+                debug_vertex_color( v ) = Vec3f(0);
+            debug_face_color( w.face() ) = Vec3f(0.3);
         }
-        DebugRenderer::edge_colors[h] = Vec3f(0.1);
+        debug_edge_color( h ) = Vec3f(0.1);
     }
 
     for(int i=1;i<no_ribs;++i) {
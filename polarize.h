@@ -51,6 +51,41 @@ void smooth_fun(const HMesh::Manifold& m,
                 const HMesh::VertexAttributeVector<int>& nailed,
                 HMesh::VertexAttributeVector<T>& fun, int iter);
 
+/** The function that is harmonic w.r.t. the smooth_fun weights everywhere except at the nailed
+ vertices, i.e. what smooth_fun converges to. The weights are not symmetric, so the system is
+ solved with BiCGSTAB, rows are scaled by the diagonal ( Jacobi preconditioning ).
+ The system depends on the geometry and on which vertices are nailed, not on the nailed values:
+ keep the solver and call solve again when only those change. */
+class HarmonicSolver
+{
+public:
+    HarmonicSolver(const HMesh::Manifold& m, const HMesh::VertexAttributeVector<int>& nailed);
+    
+    /// true if the solver was built for this geometry, this connectivity and these nailed vertices
+    bool matches(const HMesh::Manifold& m, const HMesh::VertexAttributeVector<int>& nailed) const;
+    
+    /// fun holds the nailed values on input and the field on output, the previous solution is
+    /// the starting guess. Returns the number of iterations, -1 if it did not converge
+    int solve(HMesh::VertexAttributeVector<double>& fun, double tolerance = 1e-10, int max_iter = 5000);
+    
+private:
+    std::vector<HMesh::VertexID>    free_ids;       // one unknown per free vertex
+    std::vector<HMesh::VertexID>    all_ids;
+    std::vector<CGLA::Vec3d>        positions;
+    std::vector<int>                is_nailed;
+    // one ring of each vertex of all_ids, as ManifoldCSR lists it, to detect connectivity edits
+    size_t                          no_halfedges;
+    std::vector<int>                ring_offsets;
+    std::vector<HMesh::VertexID>    ring_ids;
+    // A = I - W, W[i][j] = w_ij / sum_j w_ij over the free neighbors, B the same for the nailed ones
+    std::vector<int>                W_offsets, W_cols;
+    std::vector<double>             W_vals;
+    std::vector<int>                B_offsets;
+    std::vector<HMesh::VertexID>    B_cols;
+    std::vector<double>             B_vals;
+    std::vector<double>             x;
+};
+
 void polarize_mesh(HMesh::Manifold& m, HMesh::VertexAttributeVector<double>& fun, double vmin, double vmax, const int divisions);
 
 void show_skin(HMesh::Manifold& m, int j);